@@ -0,0 +1,320 @@
+/*
+ *  Copyright (C) 2012 Xo Wang
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL XO
+ *  WANG BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ *  AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *  Except as contained in this notice, the name of Xo Wang shall not be
+ *  used in advertising or otherwise to promote the sale, use or other dealings
+ *  in this Software without prior written authorization from Xo Wang.
+ */
+
+// Benchmarks every acceleration structure, triangle layout and intersector that rtcCreateAccel offers on the given
+// OBJ files, and prints a table of build time, memory footprint, and primary and shadow ray throughput from fixed
+// views, to choose the configuration for an asset. BVH4 traversers are also timed at several prefetch distances.
+//
+// This is a separate executable from Trayrace; the Eclipse project excludes this directory. bench/CMakeLists.txt
+// builds it along with the embree libraries, from the repo root:
+//     cmake -S bench -B bench/build -DCMAKE_BUILD_TYPE=Release && cmake --build bench/build
+
+#include "Trayrace.h"
+#include "Object.h"
+#include "Camera.h"
+#include "Transform.h"
+#include "MaterialLib.h"
+
+#include "embree/common/accel.h"
+#include "embree/common/intersector.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+
+#include <cstdlib>
+
+namespace {
+
+using namespace Trayrace;
+
+// resolution of each benchmark view
+constexpr size_t VIEW_SIZE = 512;
+// builds per configuration; the fastest is reported
+constexpr size_t BUILD_REPEATS = 3;
+// traversal passes over the ray sets per configuration; the fastest is reported
+constexpr size_t TRACE_REPEATS = 3;
+// prefetch distances the BVH4 traversers are timed with; zero is the plain kernel
+constexpr size_t PREFETCH_DISTANCES[] = { 0, 1, 2, 4 };
+
+struct Geometry {
+    embree::BuildTriangle *triangles;
+    size_t numTriangles;
+    embree::BuildVertex *vertices;
+    size_t numVertices;
+    BoundBox bounds;
+};
+
+struct RaySets {
+    std::vector<Ray> primary;
+    std::vector<Ray> shadow;
+};
+
+struct Result {
+    std::string accel;
+    std::string triangle;
+    std::string intersector;
+    size_t prefetchDistance;
+    double buildSeconds;
+    size_t bytes;
+    double primaryMraysPerSecond;
+    double shadowMraysPerSecond;
+    size_t primaryHits;
+    size_t shadowOccluded;
+};
+
+Geometry LoadGeometry(const std::vector<std::string> &paths, MaterialLib &materialLib) {
+    using namespace embree;
+
+    std::vector<std::shared_ptr<Object>> objects;
+    for (const std::string &path : paths) {
+        auto obj = std::make_shared<Object>(path, materialLib);
+        if (!obj->faces.empty()) {
+            objects.push_back(obj);
+        }
+    }
+
+    Geometry geometry;
+    geometry.numTriangles = geometry.numVertices = 0;
+    for (const auto &obj : objects) {
+        geometry.numTriangles += obj->faces.size();
+        geometry.numVertices += obj->numBuildVertices();
+    }
+
+    // kept across builds: every build is told not to free them
+    geometry.vertices = (BuildVertex *) rtcMalloc(geometry.numVertices * sizeof(BuildVertex));
+    geometry.triangles = (BuildTriangle *) rtcMalloc(geometry.numTriangles * sizeof(BuildTriangle));
+    size_t vertexOffset = 0, triangleOffset = 0;
+    geometry.bounds.setEmpty();
+    for (size_t i = 0; i < objects.size(); i++) {
+        const Object &obj = *objects[i];
+        for (size_t v = 0; v < obj.vertices.size(); v++) {
+            geometry.bounds.extend(obj.vertexAt(v, 0.f));
+            geometry.bounds.extend(obj.vertexAt(v, 1.f));
+        }
+        obj.toEmbree(i, geometry.vertices, vertexOffset, geometry.triangles, triangleOffset);
+        vertexOffset += obj.numBuildVertices();
+        triangleOffset += obj.faces.size();
+    }
+    return geometry;
+}
+
+// builds with the structure's statistics output suppressed
+embree::Ref<embree::Accel> Build(const std::string &accel, const std::string &triangle, const Geometry &geometry) {
+    std::ofstream null;
+    std::streambuf * const coutBuf = std::cout.rdbuf(null.rdbuf());
+    try {
+        embree::Ref<embree::Accel> result = embree::rtcCreateAccel(accel.c_str(),
+                triangle.c_str(),
+                geometry.triangles,
+                geometry.numTriangles,
+                geometry.vertices,
+                geometry.numVertices,
+                embree::empty,
+                false);
+        std::cout.rdbuf(coutBuf);
+        return result;
+    } catch (...) {
+        std::cout.rdbuf(coutBuf);
+        throw;
+    }
+}
+
+// camera rays from three views around the scene, and shadow rays from their hits towards a point above the scene;
+// the rays are found with a reference structure so every configuration traces the same set
+RaySets MakeRays(const Geometry &geometry) {
+    using namespace embree;
+
+    const Vector3f center = geometry.bounds.center();
+    const float radius = std::max(geometry.bounds.sizes().norm() * .5f, EPS);
+    const Vector3f lightPos = center + Vector3f(.3f, 1.5f, .2f) * radius;
+    const Vector3f viewDirs[] = {
+            Vector3f(0.f, .2f, 1.f),
+            Vector3f(1.f, .5f, -.3f),
+            Vector3f(-.7f, .9f, -.6f) };
+
+    Ref<Accel> reference = Build("bvh4.spatialsplit", "triangle4i", geometry);
+    Ref<Intersector> intersector = reference->queryInterface<Intersector>();
+
+    RaySets rays;
+    for (const Vector3f &dir : viewDirs) {
+        const float fov = 40.f * float(M_PI / 180.0);
+        const Vector3f eye = center + dir.normalized() * (radius / std::tan(fov * .5f));
+        const Camera camera(Transform::LookAt(eye, center, Vector3f(0.f, 1.f, 0.f)),
+                VIEW_SIZE,
+                VIEW_SIZE,
+                { -.5f, .5f, -.5f, .5f },
+                fov);
+        for (size_t j = 0; j < VIEW_SIZE; j++) {
+            for (size_t i = 0; i < VIEW_SIZE; i++) {
+                const Ray ray = camera.generateRay(i, j);
+                rays.primary.push_back(ray);
+
+                Hit hit;
+                intersector->intersect(ray, hit);
+                if (hit) {
+                    const Vector3f p = Eigen::Map<const Vector3f>(&ray.org.x)
+                            + hit.t * Eigen::Map<const Vector3f>(&ray.dir.x);
+                    const Vector3f toLight = lightPos - p;
+                    const float dist = toLight.norm();
+                    rays.shadow.push_back(Ray(EmbV(p), EmbV(toLight / dist), 1e-3f * radius, dist));
+                }
+            }
+        }
+    }
+    return rays;
+}
+
+void Trace(Result &result, const embree::Ref<embree::Intersector> &intersector, const RaySets &rays) {
+    using namespace embree;
+
+    double primarySeconds = inf, shadowSeconds = inf;
+    for (size_t r = 0; r < TRACE_REPEATS; r++) {
+        size_t hits = 0;
+        double t0 = getSeconds();
+        for (const Ray &ray : rays.primary) {
+            Hit hit;
+            intersector->intersect(ray, hit);
+            hits += bool(hit);
+        }
+        primarySeconds = std::min(primarySeconds, getSeconds() - t0);
+        result.primaryHits = hits;
+
+        size_t occluded = 0;
+        t0 = getSeconds();
+        for (const Ray &ray : rays.shadow) {
+            occluded += intersector->occluded(ray);
+        }
+        shadowSeconds = std::min(shadowSeconds, getSeconds() - t0);
+        result.shadowOccluded = occluded;
+    }
+    result.primaryMraysPerSecond = rays.primary.size() / primarySeconds * 1e-6;
+    result.shadowMraysPerSecond = rays.shadow.size() / shadowSeconds * 1e-6;
+}
+
+void PrintTable(const std::vector<Result> &results) {
+    using namespace std;
+
+    cout << left << setw(20) << "accel" << setw(12) << "triangle" << setw(10) << "isect"
+            << right << setw(4) << "pf" << setw(10) << "build ms" << setw(10) << "MB" << setw(12) << "prim Mr/s" << setw(12)
+            << "shdw Mr/s" << setw(10) << "hits" << setw(10) << "occluded" << '\n';
+    cout << fixed;
+    for (const Result &r : results) {
+        cout << left << setw(20) << r.accel << setw(12) << r.triangle << setw(10) << r.intersector
+                << right << setw(4) << r.prefetchDistance << setprecision(1) << setw(10) << r.buildSeconds * 1e3
+                << setprecision(2) << setw(10) << r.bytes / 1e6
+                << setprecision(3) << setw(12) << r.primaryMraysPerSecond
+                << setw(12) << r.shadowMraysPerSecond
+                << setw(10) << r.primaryHits
+                << setw(10) << r.shadowOccluded << '\n';
+    }
+    cout << flush;
+}
+
+}
+
+int main(const int argc, const char * const argv[]) {
+    using namespace Trayrace;
+    using namespace embree;
+    using namespace std;
+
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <OBJ path>..." << endl;
+        return EXIT_FAILURE;
+    }
+
+    MaterialLib materialLib;
+    const Geometry geometry = LoadGeometry(vector<string>(argv + 1, argv + argc), materialLib);
+    if (geometry.numTriangles == 0) {
+        cerr << "No triangles loaded." << endl;
+        return EXIT_FAILURE;
+    }
+    const RaySets rays = MakeRays(geometry);
+    cout << geometry.numTriangles << " triangles, " << rays.primary.size() << " primary and " << rays.shadow.size()
+            << " shadow rays" << endl;
+
+    const char * const accels[] = { "bvh2", "bvh2.spatialsplit", "bvh4", "bvh4.spatialsplit", "bvh4mb" };
+    const char * const triangles[] = { "triangle1", "triangle1i", "triangle1v", "triangle4", "triangle4i",
+            "triangle4v", "triangle4w", "triangle8c",
+#ifdef __AVX__
+            "triangle8", "triangle8w",
+#endif
+    };
+    const char * const intersectors[] = { "moeller", "pluecker", "woop" };
+
+    vector<Result> results;
+    for (const char *accelTy : accels) {
+        for (const char *triTy : triangles) {
+            for (const char *intTy : intersectors) {
+                // the intersector is selected by a suffix of the triangle type
+                const string triIntTy = string(triTy) + "." + intTy;
+                Ref<Accel> accel;
+                Ref<Intersector> intersector;
+                double buildSeconds = inf;
+                try {
+                    for (size_t r = 0; r < BUILD_REPEATS; r++) {
+                        accel = null;
+                        const double t0 = getSeconds();
+                        accel = Build(accelTy, triIntTy, geometry);
+                        buildSeconds = std::min(buildSeconds, getSeconds() - t0);
+                    }
+                    rtcSetTraversalPrefetchDistance(0);
+                    intersector = accel->queryInterface<Intersector>();
+                } catch (const runtime_error &) {
+                    // not a supported combination
+                    continue;
+                }
+
+                // only the BVH4 traverser prefetches; intersectors take the distance set when they are created
+                const bool prefetches = string(accelTy).compare(0, 5, "bvh4.") == 0 || string(accelTy) == "bvh4";
+                for (const size_t distance : PREFETCH_DISTANCES) {
+                    if (distance > 0) {
+                        if (!prefetches) {
+                            break;
+                        }
+                        rtcSetTraversalPrefetchDistance(distance);
+                        intersector = accel->queryInterface<Intersector>();
+                    }
+                    Result result = { accelTy, triTy, intTy, distance, buildSeconds, accel->bytes(), 0., 0., 0, 0 };
+                    Trace(result, intersector, rays);
+                    results.push_back(result);
+                }
+                cerr << '.' << flush;
+            }
+        }
+    }
+    cerr << endl;
+
+    PrintTable(results);
+
+    alignedFree(geometry.vertices);
+    alignedFree(geometry.triangles);
+    return EXIT_SUCCESS;
+}
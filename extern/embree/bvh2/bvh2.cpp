@@ -277,11 +277,17 @@ namespace embree
     }
   }
 
-  void BVH2::print(std::ostream& cout)
+  size_t BVH2::bytes()
   {
-    /* calculate statistics */
     numNodes = numLeaves = numPrimBlocks = numPrims = depth = 0;
     bvhSAH = statistics(root,0.0f,depth);
+    return numNodes*sizeof(Node) + numPrimBlocks*trity.bytes + numVertices*sizeof(Vec3f);
+  }
+
+  void BVH2::print(std::ostream& cout)
+  {
+    /* calculate statistics */
+    size_t bytesTotal = bytes();
     assert(depth <= BVH2::maxDepth);
 
     /* output statistics */
@@ -289,7 +295,6 @@ namespace embree
     size_t bytesNodes = numNodes     *sizeof(Node);
     size_t bytesTris  = numPrimBlocks*trity.bytes;
     size_t bytesVertices = numVertices*sizeof(Vec3f);
-    size_t bytesTotal = bytesNodes+bytesTris+bytesVertices;
     cout.setf(std::ios::scientific, std::ios::floatfield);
     cout.precision(2);
     cout << "sah = " << bvhSAH << std::endl;
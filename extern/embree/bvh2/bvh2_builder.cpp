@@ -31,19 +31,26 @@ namespace embree
       bvh(new BVH2(trity,intTy,vertices,numVertices,freeArrays))
   {
     /* generate build primitives */
+    double t0 = getSeconds();
     scheduler->start();
     PrimRefGenNormal gen(TaskScheduler::ThreadInfo(),triangles,numTriangles,vertices,numVertices,bounds,&alloc);
     scheduler->stop();
     
     /* start parallel build */
+    double t1 = getSeconds();
     scheduler->start();
     recurse(TaskScheduler::ThreadInfo(),bvh->root,1,gen.prims,gen.pinfo,gen.split);
     scheduler->stop();
 
+    double t2 = getSeconds();
     /* rotate top part of tree */
     for (int i=0; i<5; i++) bvh->rotate(bvh->root,1);
     bvh->sort(bvh->root,inf);
     bvh->clearBarrier(bvh->root);
+
+    bvh->buildTimes.primRefGen = t1-t0;
+    bvh->buildTimes.hierarchy = t2-t1;
+    bvh->buildTimes.optimize = getSeconds()-t2;
   }
 
   template<typename Heuristic>
@@ -160,6 +160,7 @@ pop_node:
         size_t num; Triangle* tri = (Triangle*) cur->leaf(num);
         for (size_t i=0; i<num; i++)
           if (TriangleIntersector::occluded(ray,tri[i],bvh->vertices)) {
+            STAT3(shadow.trav_early_outs,1,1,1);
             AVX_ZERO_UPPER();
             return true;
           }
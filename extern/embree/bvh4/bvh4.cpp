@@ -20,8 +20,11 @@
 
 namespace embree
 {
+  bool depthFirstLayout = false;
+  size_t treeletRestructuring = 0;
+
   BVH4::BVH4 (const TriangleType& trity, const std::string& intTy, const Vec3fa* vertices, size_t numVertices, bool freeVertices) 
-  : Accel(intTy), trity(trity), maxLeafTris(maxLeafBlocks*trity.blockSize), root(NULL), vertices(NULL), numVertices(0), freeVertices(freeVertices)
+  : Accel(intTy), trity(trity), maxLeafTris(maxLeafBlocks*trity.blockSize), data(NULL), root(NULL), vertices(NULL), numVertices(0), freeVertices(freeVertices)
   {
     if (trity.needVertices) {
       this->vertices = vertices;
@@ -31,6 +34,7 @@ namespace embree
 
   BVH4::~BVH4 () 
   {
+    if (data) alignedFree(data); data = NULL;
     if (freeVertices && vertices) 
       alignedFree(vertices); vertices  = NULL;
   }
@@ -108,6 +112,33 @@ namespace embree
       }
       throw std::runtime_error("unknown triangle intersector interface \""+std::string(interface)+"\"");
     }
+    else if (trity.name == "triangle4w") {
+      if (!strcmp(interface,Intersector::name)) {
+        if (intTy == "default") return new BVH4Intersector<Triangle4wIntersectorWoop>(this);
+        if (intTy == "fast"   ) return new BVH4Intersector<Triangle4wIntersectorWoop>(this);
+        if (intTy == "woop"   ) return new BVH4Intersector<Triangle4wIntersectorWoop>(this);
+        throw std::runtime_error("unknown triangle intersector \""+intTy+"\" for triangle4w");
+      }
+      throw std::runtime_error("unknown triangle intersector interface \""+std::string(interface)+"\"");
+    }
+    else if (trity.name == "triangle8w") {
+      if (!strcmp(interface,Intersector::name)) {
+        if (intTy == "default") return new BVH4Intersector<Triangle8wIntersectorWoop>(this);
+        if (intTy == "fast"   ) return new BVH4Intersector<Triangle8wIntersectorWoop>(this);
+        if (intTy == "woop"   ) return new BVH4Intersector<Triangle8wIntersectorWoop>(this);
+        throw std::runtime_error("unknown triangle intersector \""+intTy+"\" for triangle8w");
+      }
+      throw std::runtime_error("unknown triangle intersector interface \""+std::string(interface)+"\"");
+    }
+    else if (trity.name == "triangle8c") {
+      if (!strcmp(interface,Intersector::name)) {
+        if (intTy == "default") return new BVH4Intersector<Triangle8cIntersectorMoellerTrumbore>(this);
+        if (intTy == "fast"   ) return new BVH4Intersector<Triangle8cIntersectorMoellerTrumbore>(this);
+        if (intTy == "moeller") return new BVH4Intersector<Triangle8cIntersectorMoellerTrumbore>(this);
+        throw std::runtime_error("unknown triangle intersector \""+intTy+"\" for triangle8c");
+      }
+      throw std::runtime_error("unknown triangle intersector interface \""+std::string(interface)+"\"");
+    }
     throw std::runtime_error("unknown BVH4 triangle type \""+std::string(trity.name)+"\"");
     return null;
   }
@@ -124,6 +155,12 @@ namespace embree
     for (size_t c=0; c<4; c++)
       cdepth[c] = (int)rotate(parent->child[c],depth+1);
 
+    rotateNode(parent,depth,cdepth);
+    return 1+reduce_max(cdepth);
+  }
+
+  bool BVH4::rotateNode(Node* parent, size_t depth, ssei& cdepth)
+  {
     /* compute current area of all children */
     ssef sizeX = parent->upper_x-parent->lower_x;
     ssef sizeY = parent->upper_y-parent->lower_y;
@@ -207,7 +244,7 @@ namespace embree
     }
 
     /*! if we did not find a swap that improves the SAH then do nothing */
-    if (bestCost >= 0) return 1+reduce_max(cdepth);
+    if (bestCost >= 0) return false;
 
     /*! perform the best found tree rotation */
     Node* child = parent->child[bestChild]->node();
@@ -222,7 +259,181 @@ namespace embree
     /*! This returned depth is conservative as the child that was
      *  pulled up in the tree could have been on the critical path. */
     cdepth[bestOther]++; // bestOther was pushed down one level
-    return 1+reduce_max(cdepth); 
+    return true;
+  }
+
+  /*! Treelet of a BVH4 node and the topology of lowest SAH cost over
+   *  its subtrees, found by dynamic programming over all their
+   *  subsets. The SAH cost of a topology is the surface area of its
+   *  inner nodes; the subtrees keep their own cost. */
+  struct Treelet
+  {
+    typedef BVH4::Base Base;
+    typedef BVH4::Node Node;
+    static const size_t maxLeaves = BVH4::maxTreeletLeaves;
+    static const size_t maxSets = 1 << maxLeaves;
+
+    /*! Grows the treelet from the children of the root, expanding the
+     *  inner child of largest surface area while the subtrees fit. */
+    Treelet (Node* root, const size_t cdepth[4])
+      : numLeaves(0), numNodes(0), oldCost(0.0f)
+    {
+      nodes[numNodes++] = root;
+      for (size_t c=0; c<4; c++) {
+        if (root->child[c]->isEmptyLeaf()) continue;
+        leaves[numLeaves] = root->child[c]; leafBounds[numLeaves] = root->get(c); leafDepth[numLeaves] = cdepth[c];
+        numLeaves++;
+      }
+
+      while (true)
+      {
+        ssize_t best = -1; float bestArea = neg_inf;
+        for (size_t i=0; i<numLeaves; i++) {
+          if (leaves[i]->isBarrier() || leaves[i]->isLeaf()) continue;
+          const size_t num = numChildren(leaves[i]->node());
+          if (num < 2 || numLeaves-1+num > maxLeaves) continue;
+          const float area = halfArea(leafBounds[i]);
+          if (area > bestArea) { best = i; bestArea = area; }
+        }
+        if (best == -1) break;
+
+        /*! the expanded node's children replace it, one level deeper */
+        Node* node = leaves[best]->node();
+        const size_t depth = leafDepth[best];
+        nodes[numNodes++] = node;
+        oldCost += BVH4::travCost*bestArea;
+        numLeaves--;
+        leaves[best] = leaves[numLeaves]; leafBounds[best] = leafBounds[numLeaves]; leafDepth[best] = leafDepth[numLeaves];
+        for (size_t c=0; c<4; c++) {
+          if (node->child[c]->isEmptyLeaf()) continue;
+          leaves[numLeaves] = node->child[c]; leafBounds[numLeaves] = node->get(c); leafDepth[numLeaves] = depth-1;
+          numLeaves++;
+        }
+      }
+    }
+
+    static size_t numChildren(const Node* node) {
+      size_t num = 0;
+      for (size_t c=0; c<4; c++) num += !node->child[c]->isEmptyLeaf();
+      return num;
+    }
+
+    /*! Computes the best topology of every subset of the subtrees,
+     *  splitting it into 2, 3, or 4 children. */
+    void optimize()
+    {
+      const size_t sets = size_t(1) << numLeaves;
+      for (size_t S=1; S<sets; S++)
+      {
+        const size_t low = S & (0-S);
+        const size_t rest = S^low;
+        const size_t i = __bsf(low);
+        bounds[S] = rest ? merge(leafBounds[i],bounds[rest]) : leafBounds[i];
+        cost[S] = cost2[S] = cost3[S] = cost4[S] = inf;
+        if (!rest) { cost[S] = 0.0f; continue; }
+
+        /*! the child holding the lowest subtree is chosen here, the
+         *  other children are the best partition of the rest */
+        for (size_t T=rest;; T=(T-1)&rest) {
+          const size_t U = T|low, R = S^U;
+          if (R) {
+            if (cost[U]+cost [R] < cost2[S]) { cost2[S] = cost[U]+cost [R]; part2[S] = (unsigned char)U; }
+            if (cost[U]+cost2[R] < cost3[S]) { cost3[S] = cost[U]+cost2[R]; part3[S] = (unsigned char)U; }
+            if (cost[U]+cost3[R] < cost4[S]) { cost4[S] = cost[U]+cost3[R]; part4[S] = (unsigned char)U; }
+          }
+          if (!T) break;
+        }
+        num[S] = 4; float best = cost4[S];
+        if (cost3[S] <= best) { num[S] = 3; best = cost3[S]; }
+        if (cost2[S] <= best) { num[S] = 2; best = cost2[S]; }
+        cost[S] = BVH4::travCost*halfArea(bounds[S])+best;
+      }
+    }
+
+    /*! Splits a subset into the children of its best topology. */
+    size_t parts(size_t S, size_t part[4]) const
+    {
+      const size_t n = num[S];
+      for (size_t i=0; i<n-1; i++) {
+        const size_t k = n-i;
+        part[i] = k == 4 ? part4[S] : k == 3 ? part3[S] : part2[S];
+        S ^= part[i];
+      }
+      part[n-1] = S;
+      return n;
+    }
+
+    /*! Depth of the best topology over a subset. */
+    size_t depth(size_t S) const
+    {
+      if (!(S & (S-1))) return leafDepth[__bsf(S)];
+      size_t part[4], d = 0;
+      for (size_t i=0, n=parts(S,part); i<n; i++) d = max(d,depth(part[i]));
+      return d+1;
+    }
+
+    /*! Rebuilds the best topology over a subset from the treelet's
+     *  nodes, the root first, allocating nodes once they run out. */
+    Base* build(const TaskScheduler::ThreadInfo& thread, BVH4* bvh, size_t S, size_t& nextNode)
+    {
+      if (!(S & (S-1))) return leaves[__bsf(S)];
+      Node* node = nextNode < numNodes ? nodes[nextNode++] : (Node*) bvh->alloc.malloc(thread,sizeof(Node),1 << BVH4::alignment);
+      size_t part[4]; const size_t n = parts(S,part);
+      Base* child[4];
+      for (size_t i=0; i<n; i++) child[i] = build(thread,bvh,part[i],nextNode);
+      node->clear();
+      for (size_t i=0; i<n; i++) node->set(i,bounds[part[i]],child[i]);
+      return Base::encodeNode(node);
+    }
+
+    /*! Replaces the treelet by its best topology if that lowers the
+     *  SAH cost and keeps within the maximal depth. Returns the new
+     *  depth, or 0 if the treelet was left unchanged. */
+    __noinline static size_t restructure(const TaskScheduler::ThreadInfo& thread, BVH4* bvh, Node* root, const size_t cdepth[4], size_t depth)
+    {
+      Treelet treelet(root,cdepth);
+      if (treelet.numNodes == 1) return 0;
+      treelet.optimize();
+
+      const size_t all = (size_t(1) << treelet.numLeaves)-1;
+      const float newCost = treelet.cost[all]-BVH4::travCost*halfArea(treelet.bounds[all]);
+      if (newCost >= 0.999f*treelet.oldCost) return 0;
+      const size_t newDepth = treelet.depth(all);
+      if (depth+newDepth > BVH4::maxDepth) return 0;
+
+      size_t nextNode = 0;
+      treelet.build(thread,bvh,all,nextNode);
+      return newDepth;
+    }
+
+  public:
+    size_t numLeaves;                   //!< number of subtrees
+    Base* leaves[maxLeaves];            //!< roots of the subtrees
+    BBox3f leafBounds[maxLeaves];       //!< bounds of the subtrees
+    size_t leafDepth[maxLeaves];        //!< depth of the subtrees
+    size_t numNodes;                    //!< number of inner nodes, the root first
+    Node* nodes[maxLeaves];             //!< inner nodes of the treelet
+    float oldCost;                      //!< cost of the inner nodes below the root
+    BBox3f bounds[maxSets];             //!< bounds of each subset
+    float cost[maxSets];                //!< cost of the best topology of each subset
+    float cost2[maxSets], cost3[maxSets], cost4[maxSets];             //!< cost of the best partition into 2, 3, 4 children
+    unsigned char part2[maxSets], part3[maxSets], part4[maxSets];     //!< first child of these partitions
+    unsigned char num[maxSets];         //!< number of children of the best topology
+  };
+
+  size_t BVH4::restructure(const TaskScheduler::ThreadInfo& thread, Base* nodeID, size_t depth)
+  {
+    if (nodeID->isBarrier()) return maxLocalDepth;
+    if (nodeID->isLeaf()) return 0;
+    Node* node = nodeID->node();
+
+    /*! restructure all children first */
+    size_t cdepth[4];
+    for (size_t c=0; c<4; c++)
+      cdepth[c] = restructure(thread,node->child[c],depth+1);
+
+    if (size_t newDepth = Treelet::restructure(thread,this,node,cdepth,depth)) return newDepth;
+    return 1+max(max(cdepth[0],cdepth[1]),max(cdepth[2],cdepth[3]));
   }
 
   float BVH4::sort(Base* node, int maxDepth)
@@ -289,6 +500,84 @@ namespace embree
     }
   }
 
+  BVH4::Base* BVH4::relayout(Base* node, char* data, size_t& offset)
+  {
+    /*! copy triangle blocks, keeping empty leaves as they are */
+    if (node->isLeaf()) 
+    {
+      size_t num; char* tri = node->leaf(num);
+      if (num == 0) return node;
+      offset = (offset+(1 << alignment)-1) & ~size_t((1 << alignment)-1);
+      char* dst = data+offset; offset += num*trity.bytes;
+      if (data) memcpy(dst,tri,num*trity.bytes);
+      return Base::encodeLeaf(dst,num);
+    }
+
+    /*! nodes start at a cache line so that they touch only two */
+    const Node* n = node->node();
+    offset = (offset+63) & ~size_t(63);
+    Node* dst = (Node*)(data+offset); offset += sizeof(Node);
+    if (data) *dst = *n;
+
+    /*! leaves follow their parent, they are tested right after it */
+    for (size_t c=0; c<4; c++) {
+      if (!n->child[c]->isLeaf()) continue;
+      Base* child = relayout(n->child[c],data,offset);
+      if (data) dst->child[c] = child;
+    }
+
+    /*! inner children follow by decreasing surface area, so the most
+     *  likely visited one is adjacent */
+    const ssef dx = n->upper_x-n->lower_x;
+    const ssef dy = n->upper_y-n->lower_y;
+    const ssef dz = n->upper_z-n->lower_z;
+    const ssef area = dx*(dy+dz)+dy*dz;
+    size_t order[4], numInner = 0;
+    for (size_t c=0; c<4; c++) {
+      if (n->child[c]->isLeaf()) continue;
+      size_t i = numInner++;
+      for (; i>0 && area[order[i-1]] < area[c]; i--) order[i] = order[i-1];
+      order[i] = c;
+    }
+    for (size_t i=0; i<numInner; i++) {
+      Base* child = relayout(n->child[order[i]],data,offset);
+      if (data) dst->child[order[i]] = child;
+    }
+    return Base::encodeNode(dst);
+  }
+
+  void BVH4::relayout()
+  {
+    size_t bytes = 0;
+    relayout(root,NULL,bytes);
+    char* block = (char*) alignedMallocLarge(bytes);
+    size_t offset = 0;
+    root = relayout(root,block,offset);
+    assert(offset == bytes);
+    alloc.clear();
+    if (data) alignedFree(data);
+    data = block;
+  }
+
+  Ref<BVH4> BVH4::copy()
+  {
+    Vec3fa* v = NULL;
+    if (vertices) {
+      v = (Vec3fa*) alignedMallocLarge(numVertices*sizeof(Vec3fa));
+      std::copy(vertices,vertices+numVertices,v);
+    }
+    Ref<BVH4> bvh = new BVH4(trity,intTy,v,numVertices,true);
+
+    size_t bytes = 0;
+    relayout(root,NULL,bytes);
+    bvh->data = (char*) alignedMallocLarge(bytes);
+    size_t offset = 0;
+    bvh->root = relayout(root,bvh->data,offset);
+    assert(offset == bytes);
+    bvh->buildTimes = buildTimes;
+    return bvh;
+  }
+
   float BVH4::statistics(Base* node, float ap, size_t& depth)
   {
     if (node->isNode())
@@ -322,11 +611,17 @@ namespace embree
     }
   }
 
-  void BVH4::print(std::ostream& cout)
+  size_t BVH4::bytes()
   {
-    /* calculate statistics */
     numNodes = numLeaves = numPrimBlocks = numPrims = depth = 0;
     bvhSAH = statistics(root,0.0f,depth);
+    return numNodes*sizeof(Node) + numPrimBlocks*trity.bytes + numVertices*sizeof(Vec3f);
+  }
+
+  void BVH4::print(std::ostream& cout)
+  {
+    /* calculate statistics */
+    size_t bytesTotal = bytes();
     assert(depth <= BVH4::maxDepth);
 
     /* output statistics */
@@ -334,7 +629,6 @@ namespace embree
     size_t bytesNodes = numNodes     *sizeof(Node);
     size_t bytesTris  = numPrimBlocks*trity.bytes;
     size_t bytesVertices = numVertices*sizeof(Vec3f);
-    size_t bytesTotal = bytesNodes+bytesTris+bytesVertices;
     cout.setf(std::ios::scientific, std::ios::floatfield);
     cout.precision(2);
     cout << "sah = " << bvhSAH << std::endl;
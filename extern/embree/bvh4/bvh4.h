@@ -23,6 +23,15 @@
 
 namespace embree
 {
+  /*! Enables copying BVH4s into one block in depth first order after
+   *  the build, see rtcSetDepthFirstLayout. */
+  extern bool depthFirstLayout;
+
+  /*! Number of treelet restructuring rounds BVH4 builders run over the
+   *  finished tree in place of rotations, see
+   *  rtcSetTreeletRestructuring. */
+  extern size_t treeletRestructuring;
+
   /*! Multi BVH with 4 children. Each node stores the bounding box of
    * it's 4 children as well as a 4 child pointers. */
   class BVH4 : public Accel
@@ -49,6 +58,9 @@ namespace embree
 
     /*! Cost of one traversal step. */
     static const int travCost = 1;                      
+
+    /*! Maximal number of subtrees a restructured treelet spans. */
+    static const size_t maxTreeletLeaves = 7;
     
     /*! BVH4 Node */
     struct Node
@@ -108,26 +120,54 @@ namespace embree
     /*! Print statistics of the BVH. */
     void print(std::ostream& cout);
 
+    /*! Memory used by nodes, triangle blocks, and the vertices they reference. */
+    size_t bytes();
+
     /*! Rotates tree to improve SAH cost. */
     size_t rotate(Base* node, size_t depth);
 
+    /*! Performs the best rotation between a node and its children,
+     *  whose subtree depths are given, if it improves SAH cost.
+     *  Returns whether the node was rotated. */
+    bool rotateNode(Node* node, size_t depth, ssei& cdepth);
+
+    /*! Restructures the tree bottom up. At each node, the treelet
+     *  grown from its children by expanding the largest inner ones,
+     *  up to maxTreeletLeaves subtrees, is replaced by the topology of
+     *  lowest SAH cost over these subtrees. Returns the depth of the
+     *  tree. */
+    size_t restructure(const TaskScheduler::ThreadInfo& thread, Base* node, size_t depth);
+
     /*! Sort tree to improve shadow ray performance. */
     float sort(Base* node, int maxDepth);
 
     /*! Clears the barrier bits. */
     void clearBarrier(Base*& node);
 
+    /*! Copies nodes and triangles into one contiguous block, in depth
+     *  first order with the leaves of a node right after it and its
+     *  larger children first, and releases the build's scattered
+     *  allocation blocks. */
+    void relayout();
+
+    /*! Creates a copy of the BVH, laid out like relayout() does, with
+     *  its own vertex array. The copy's memory is first touched by the
+     *  calling thread, which places it on that thread's NUMA node. */
+    Ref<BVH4> copy();
+
     /*! Data of the BVH */
   public:
     const TriangleType& trity;         //!< triangle type stored in BVH
     const size_t maxLeafTris;          //!< maximal number of triangles per leaf
     AllocatorPerThread alloc;          //!< allocator for nodes and triangles
+    char* data;                        //!< contiguous block of nodes and triangles after relayout, or NULL
     Base* root;                        //!< Root node (can also be a leaf).
     const Vec3fa* vertices;            //!< Pointer to vertex array.
     size_t numVertices;                //!< Number of vertices
     bool freeVertices;                 //!< Should we delete the vertex array?
 
   private:
+    Base* relayout(Base* node, char* data, size_t& offset);
     float statistics(Base* node, float area, size_t& depth);
     float bvhSAH;                      //!< SAH cost of the BVH.
     size_t numNodes;                   //!< Number of internal nodes.
@@ -29,19 +29,28 @@ namespace embree
       bvh(new BVH4(trity,intTy,vertices,numVertices,freeVertices))
   {
     /* generate build primitives */
+    double t0 = getSeconds();
     scheduler->start();
     PrimRefGenNormal gen(TaskScheduler::ThreadInfo(),triangles,numTriangles,vertices,numVertices,bounds,&alloc);
     scheduler->stop();
     
     /* start parallel build */
+    double t1 = getSeconds();
     scheduler->start();
     recurse(TaskScheduler::ThreadInfo(),bvh->root,1,gen.prims,gen.pinfo,gen.split);
     scheduler->stop();
 
-    /* rotate top part of tree */
-    for (int i=0; i<5; i++) bvh->rotate(bvh->root,1);
+    double t2 = getSeconds();
+    /* restructure or rotate top part of tree */
+    if (treeletRestructuring) for (size_t i=0; i<treeletRestructuring; i++) bvh->restructure(TaskScheduler::ThreadInfo(),bvh->root,1);
+    else for (int i=0; i<5; i++) bvh->rotate(bvh->root,1);
     bvh->sort(bvh->root,inf);
     bvh->clearBarrier(bvh->root);
+    if (depthFirstLayout) bvh->relayout();
+
+    bvh->buildTimes.primRefGen = t1-t0;
+    bvh->buildTimes.hierarchy = t2-t1;
+    bvh->buildTimes.optimize = getSeconds()-t2;
   }
 
   template<typename Heuristic>
@@ -72,7 +81,7 @@ namespace embree
   typename BVH4::Base* BVH4Builder<Heuristic>::createLeaf(const TaskScheduler::ThreadInfo& thread, atomic_set<PrimRefBlock>& prims, const PrimInfo& pinfo)
   {
     /* allocate leaf node */
-    size_t blocks = trity.blocks(pinfo.size());
+    size_t blocks = trity.blocks(pinfo.size(),atomic_set<PrimRefBlock>::block_iterator_unsafe(prims),triangles);
     char* leaf = (char*) bvh->alloc.malloc(thread,blocks*trity.bytes,1 << BVH4::alignment);
 
     /* insert all triangles */
@@ -104,15 +113,16 @@ namespace embree
   {
     This->thread = &thread;
     This->depth = max(This->depth,BVH4::maxDepth-BVH4::maxLocalDepth+1);
-    This->dst = This->recurse(This->depth,This->prims,This->pinfo,This->split);
-    for (int i=0; i<5; i++) This->parent->bvh->rotate(This->dst,This->depth);
+    size_t subtreeDepth;
+    This->dst = This->recurse(This->depth,This->prims,This->pinfo,This->split,subtreeDepth);
+    for (size_t i=0; i<treeletRestructuring; i++) This->parent->bvh->restructure(thread,This->dst,This->depth);
     This->parent->bvh->sort(This->dst,inf);
     This->dst = This->dst->setBarrier();
     delete This;
   }
 
   template<typename Heuristic>
-  typename BVH4::Base* BVH4Builder<Heuristic>::BuildTask::recurse(size_t depth, atomic_set<PrimRefBlock>& prims, const PrimInfo& pinfo, const Split& split)
+  typename BVH4::Base* BVH4Builder<Heuristic>::BuildTask::recurse(size_t depth, atomic_set<PrimRefBlock>& prims, const PrimInfo& pinfo, const Split& split, size_t& subtreeDepth)
   {
     /*! compute leaf and split cost */
     const float leafSAH  = parent->trity.intCost*pinfo.sah();
@@ -122,6 +132,7 @@ namespace embree
 
     /*! create a leaf node when threshold reached or SAH tells us to stop */
     if (pinfo.size() <= 1 || depth > BVH4::maxDepth || (pinfo.size() <= parent->bvh->maxLeafTris && leafSAH <= splitSAH)) {
+      subtreeDepth = 0;
       return parent->createLeaf(*thread,prims,pinfo);
     }
 
@@ -155,7 +166,16 @@ namespace embree
 
     /*! create an inner node */
     BVH4::Node* node = (BVH4::Node*) parent->bvh->alloc.malloc(*thread,sizeof(BVH4::Node),1 << BVH4::alignment); node->clear();
-    for (size_t i=0; i<numChildren; i++) node->set(i,cinfo[i].geomBounds,recurse(depth+1,cprims[i],cinfo[i],csplit[i]));
+    ssei cdepth(zero);
+    for (size_t i=0; i<numChildren; i++) {
+      size_t d; node->set(i,cinfo[i].geomBounds,recurse(depth+1,cprims[i],cinfo[i],csplit[i],d)); cdepth[i] = (int)d;
+    }
+
+    /*! rotate while the children are still in cache, this replaces
+     *  separate rotation passes over the finished subtree */
+    if (!treeletRestructuring) 
+      for (int i=0; i<5 && parent->bvh->rotateNode(node,depth,cdepth); i++);
+    subtreeDepth = 1+reduce_max(cdepth);
     return BVH4::Base::encodeNode(node);
   }
 
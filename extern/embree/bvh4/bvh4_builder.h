@@ -77,8 +77,10 @@ namespace embree
       /*! Task entry function. */
       static void run(const TaskScheduler::ThreadInfo& thread, BuildTask* This, size_t elts);
 
-      /*! Recursively finishes the BVH construction. */
-      BVH4::Base* recurse(size_t depth, atomic_set<PrimRefBlock>& prims, const PrimInfo& pinfo, const Split& split);
+      /*! Recursively finishes the BVH construction, rotating each
+       *  node as soon as its children are done, and returns the depth
+       *  of the subtree. */
+      BVH4::Base* recurse(size_t depth, atomic_set<PrimRefBlock>& prims, const PrimInfo& pinfo, const Split& split, size_t& subtreeDepth);
 
     private:
       const TaskScheduler::ThreadInfo* thread;   //!< Task ID for fast thread local storage.
@@ -279,18 +279,23 @@ namespace embree
     }
   }
 
-  void BVH4MB::print(std::ostream& cout)
+  size_t BVH4MB::bytes()
   {
-    /* calculate statistics */
     numNodes = numLeaves = numPrimBlocks = numPrims = depth = 0;
     bvhSAH = statistics(root,0.0f,depth);
+    return numNodes*sizeof(Node) + numPrimBlocks*trity.bytes + numVertices*sizeof(Vec3f);
+  }
+
+  void BVH4MB::print(std::ostream& cout)
+  {
+    /* calculate statistics */
+    size_t bytesTotal = bytes();
 
     /* output statistics */
     std::ios::fmtflags flags = std::cout.flags();
     size_t bytesNodes = numNodes     *sizeof(Node);
     size_t bytesTris  = numPrimBlocks*trity.bytes;
     size_t bytesVertices = numVertices*sizeof(Vec3f);
-    size_t bytesTotal = bytesNodes+bytesTris+bytesVertices;
     cout.setf(std::ios::scientific, std::ios::floatfield);
     cout.precision(2);
     cout << "sah = " << bvhSAH << std::endl;
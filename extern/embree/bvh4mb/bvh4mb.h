@@ -146,6 +146,9 @@ namespace embree
     /*! Print statistics of the BVH. */
     void print(std::ostream& cout);
 
+    /*! Memory used by nodes, triangle blocks, and the vertices they reference. */
+    size_t bytes();
+
     /*! Rotates tree to improve SAH cost. */
     size_t rotate(Base* node, size_t depth);
 
@@ -29,17 +29,24 @@ namespace embree
       bvh(new BVH4MB(trity,intTy,vertices,numVertices,freeData))
   {
     /* generate build primitives */
+    double t0 = getSeconds();
     scheduler->start();
     PrimRefGenNormal gen(TaskScheduler::ThreadInfo(),triangles,numTriangles,vertices,numVertices,bounds,&alloc);
     scheduler->stop();
     
     /* start parallel build */
+    double t1 = getSeconds();
     scheduler->start();
     recurse(TaskScheduler::ThreadInfo(),bvh->root,1,gen.prims,gen.pinfo,gen.split);
     scheduler->stop();
 
+    double t2 = getSeconds();
     /*! refit top part of tree */
     bvh->refit(bvh->root);
+
+    bvh->buildTimes.primRefGen = t1-t0;
+    bvh->buildTimes.hierarchy = t2-t1;
+    bvh->buildTimes.optimize = getSeconds()-t2;
   }
 
   template<typename Heuristic>
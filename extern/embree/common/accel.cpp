@@ -25,6 +25,7 @@
 /* include BVH4 */
 #include "../bvh4/bvh4.h"
 #include "../bvh4/bvh4_builder.h"
+#include "../bvh4/bvh4_intersector.h"
 
 /* include BVH4MB */
 #include "../bvh4mb/bvh4mb.h"
@@ -49,15 +50,42 @@ namespace embree
   const Triangle1 ::Type Triangle1 ::type;
   const Triangle4 ::Type Triangle4 ::type;
   const Triangle8 ::Type Triangle8 ::type;
+  const Triangle4w::Type Triangle4w::type;
+  const Triangle8w::Type Triangle8w::type;
+  const Triangle8c::Type Triangle8c::type;
  
   void* rtcMalloc(size_t bytes) {
-    return alignedMalloc(bytes);
+    return alignedMallocLarge(bytes);
   }
 
   void rtcFreeMemory() {
     Alloc::global.clear();
   }
 
+  void rtcSetSpatialSplitBudget(float duplications) {
+    spatialSplitBudget = max(duplications,0.0f);
+  }
+
+  void rtcSetEarlySplitThreshold(float area) {
+    earlySplitThreshold = max(area,0.0f);
+  }
+
+  void rtcSetTraversalPrefetchDistance(size_t distance) {
+    traversalPrefetchDistance = distance;
+  }
+
+  void rtcSetDepthFirstLayout(bool enable) {
+    depthFirstLayout = enable;
+  }
+
+  void rtcSetTreeletRestructuring(size_t rounds) {
+    treeletRestructuring = rounds;
+  }
+
+  void rtcSetHugePages(bool enable) {
+    hugePages = enable;
+  }
+
   template<typename Builder>
   Ref<Accel> build(const TriangleType& trity, const std::string& intTy,
                    const BuildTriangle* triangles, size_t numTriangles, 
@@ -82,6 +110,8 @@ namespace embree
     double dt = getSeconds()-t0;
 #endif
 
+    bvh->buildTimes.total = dt;
+
     if (freeArrays) 
     {
       /*! free vertices if no longer required */
@@ -212,6 +242,12 @@ namespace embree
         return build<BVH4Builder<HeuristicBinning<Triangle4::logBlockSize> > >(Triangle4::type,intTy,triangles,numTriangles,vertices,numVertices,bounds,freeData);
       else if (triTy == "triangle8")
          return build<BVH4Builder<HeuristicBinning<Triangle8::logBlockSize> > >(Triangle8::type,intTy,triangles,numTriangles,vertices,numVertices,bounds,freeData);
+      else if (triTy == "triangle4w")
+        return build<BVH4Builder<HeuristicBinning<Triangle4w::logBlockSize> > >(Triangle4w::type,intTy,triangles,numTriangles,vertices,numVertices,bounds,freeData);
+      else if (triTy == "triangle8w")
+        return build<BVH4Builder<HeuristicBinning<Triangle8w::logBlockSize> > >(Triangle8w::type,intTy,triangles,numTriangles,vertices,numVertices,bounds,freeData);
+      else if (triTy == "triangle8c")
+        return build<BVH4Builder<HeuristicBinning<Triangle8c::logBlockSize> > >(Triangle8c::type,intTy,triangles,numTriangles,vertices,numVertices,bounds,freeData);
       else {
         throw std::runtime_error("invalid triangle type for bvh4: "+std::string(triTy));
         return null;
@@ -241,6 +277,12 @@ namespace embree
         return build<BVH4Builder<HeuristicSpatial<Triangle4::logBlockSize> > >(Triangle4::type,intTy,triangles,numTriangles,vertices,numVertices,bounds,freeData);
       else if (triTy == "triangle8")
         return build<BVH4Builder<HeuristicSpatial<Triangle8::logBlockSize> > >(Triangle8::type,intTy,triangles,numTriangles,vertices,numVertices,bounds,freeData);
+      else if (triTy == "triangle4w")
+        return build<BVH4Builder<HeuristicSpatial<Triangle4w::logBlockSize> > >(Triangle4w::type,intTy,triangles,numTriangles,vertices,numVertices,bounds,freeData);
+      else if (triTy == "triangle8w")
+        return build<BVH4Builder<HeuristicSpatial<Triangle8w::logBlockSize> > >(Triangle8w::type,intTy,triangles,numTriangles,vertices,numVertices,bounds,freeData);
+      else if (triTy == "triangle8c")
+        return build<BVH4Builder<HeuristicSpatial<Triangle8c::logBlockSize> > >(Triangle8c::type,intTy,triangles,numTriangles,vertices,numVertices,bounds,freeData);
       else {
         throw std::runtime_error("invalid triangle type for bvh4: "+std::string(triTy));
         return null;
@@ -265,4 +307,10 @@ namespace embree
       return null;
     }
   }
+
+  Ref<Accel> rtcCopyAccel(const Ref<Accel>& accel)
+  {
+    if (BVH4* bvh = dynamic_cast<BVH4*>(accel.ptr)) return bvh->copy().ptr;
+    return null;
+  }
 }
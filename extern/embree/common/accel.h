@@ -27,6 +27,40 @@ namespace embree
   /*! Frees all unused internal memory. */
   void rtcFreeMemory();
 
+  /*! Limits the triangle references spatial and early splits may add,
+   *  as a fraction of the number of input triangles. Once the budget
+   *  is used up, the builders fall back to object splits. */
+  void rtcSetSpatialSplitBudget(float duplications);
+
+  /*! Lets all builders split triangles whose bounds are larger than
+   *  the given fraction of the scene's surface area, and mostly empty,
+   *  into several tighter build primitives. The added references count
+   *  against the spatial split budget. Zero disables this. */
+  void rtcSetEarlySplitThreshold(float area);
+
+  /*! Makes BVH4 intersectors created from now on prefetch the nodes
+   *  they are about to visit, and the vertices of indexed leaves. The
+   *  distance is how many stack entries ahead of the next pop a node
+   *  gets prefetched again. Zero disables prefetching. */
+  void rtcSetTraversalPrefetchDistance(size_t distance);
+
+  /*! Makes BVH4 builders copy the finished tree into one contiguous
+   *  block, nodes in depth first order with their leaves next to
+   *  them, and release the blocks it was built in. */
+  void rtcSetDepthFirstLayout(bool enable);
+
+  /*! Makes BVH4 builders run the given number of treelet
+   *  restructuring rounds over the finished tree instead of tree
+   *  rotations. Each round replaces the treelet below every node,
+   *  bottom up, by the topology of lowest SAH cost over its up to 7
+   *  subtrees. Zero keeps the rotations. */
+  void rtcSetTreeletRestructuring(size_t rounds);
+
+  /*! Makes memory allocated from now on for nodes, triangles, and
+   *  rtcMalloc arrays of at least 2 MB use huge pages where the system
+   *  provides them, to reduce TLB misses during traversal. */
+  void rtcSetHugePages(bool enable);
+
   /*! Triangle interface structure to the builder. The builders get an
    *  indexed face set as input, consisting of an array of vertices
    *  and triangles. If the topmost bit of id0 is set, the vertex IDs
@@ -67,6 +101,9 @@ namespace embree
     /*! A virtual destructor is required. */
     virtual ~Accel () {}
 
+    /*! Memory held by the structure in bytes. */
+    virtual size_t bytes() = 0;
+
     /*! type safe interface query */
     template<typename Interface> Ref<Interface> queryInterface() {
       return dynamic_cast<Interface*>(query(Interface::name).ptr);
@@ -81,6 +118,20 @@ namespace embree
 
     /*! intersector type */
     const std::string intTy;
+
+  public:
+
+    /*! Durations of the build phases in seconds. */
+    struct BuildTimes {
+      BuildTimes () : primRefGen(0), hierarchy(0), optimize(0), total(0) {}
+      double primRefGen;  //!< generation of the build primitives
+      double hierarchy;   //!< recursive construction of the hierarchy and its leaves
+      double optimize;    //!< post-passes over the finished tree
+      double total;       //!< complete build
+    };
+
+    /*! timings of the build that created this structure */
+    BuildTimes buildTimes;
   };
 
   /*! Creates acceleration structure of specified type. Input is a
@@ -95,6 +146,11 @@ namespace embree
                             size_t numVertices,              //!< number of vertices in array
                             const BBox3f& bounds = empty,    //!< optional approximate bounding box of the geometry
                             bool freeArrays = true);         //!< if true, triangle and vertex arrays are freed when no longer needed
+
+  /*! Copies a BVH4 into memory first touched by the calling thread,
+   *  so that threads bound to another NUMA node can traverse a local
+   *  replica. Returns null for other structures. */
+  Ref<Accel> rtcCopyAccel(const Ref<Accel>& accel);
 }
 
 #endif
@@ -18,6 +18,17 @@
 
 namespace embree
 {
+  bool hugePages = false;
+
+  void* alignedMallocLarge(size_t bytes)
+  {
+    if (!hugePages || bytes < hugePageSize) 
+      return alignedMalloc(bytes);
+    void* ptr = alignedMalloc(bytes,hugePageSize);
+    os_advise_huge_pages(ptr,bytes);
+    return ptr;
+  }
+
   Alloc Alloc::global;
 
   Alloc::Alloc () {
@@ -35,7 +46,7 @@ namespace embree
   {
     Lock<MutexSys> lock(mutex);
     for (size_t i=0; i<blocks.size(); i++)
-      alignedFree(blocks[i]);
+      os_free_pages(blocks[i],blockSize);
     blocks.clear();
   }
   
@@ -47,7 +58,7 @@ namespace embree
       blocks.pop_back();
       return ptr;
     }
-    return alignedMalloc(blockSize,64);
+    return os_malloc_pages(blockSize,hugePages);
   }
   
   void Alloc::free(void* ptr) 
@@ -25,6 +25,15 @@
 
 namespace embree
 {
+  /*! Enables huge pages for the memory pool blocks and for large
+   *  arrays, see rtcSetHugePages. */
+  extern bool hugePages;
+
+  /*! Allocates memory to be freed with alignedFree. With huge pages
+   *  enabled, allocations of at least one huge page are aligned to
+   *  huge pages and advised to be backed by them. */
+  void* alignedMallocLarge(size_t bytes);
+
   /*! Global memory pool. Node, triangle, and intermediary build data
       is allocated from this memory pool and returned to it. The pool
       does not return memory to the operating system unless the clear function
@@ -79,6 +88,17 @@ namespace embree
       }
     }
 
+    /*! Returns all allocated blocks to Alloc class. */
+    void clear() 
+    {
+      Lock<MutexSys> lock(mutex);
+      for (size_t i=0; i<blocks.size(); i++) {
+        Alloc::global.free(blocks[i]); 
+      }
+      blocks.clear();
+      ptr = NULL; cur = end = 0;
+    }
+
     /*! Allocates some number of bytes. */
     void* malloc(size_t bytes) 
     {
@@ -131,6 +151,15 @@ namespace embree
       return thread[tinfo.id].malloc(bytes,align,this);
     }
 
+    /*! Returns all memory to Alloc class. Everything allocated so far
+     *  becomes invalid. */
+    void clear() {
+      for (size_t i=0; i<getNumberOfLogicalThreads(); i++) {
+        thread[i].ptr = NULL; thread[i].cur = thread[i].end = 0;
+      }
+      AllocatorBase::clear();
+    }
+
   private:
 
      /*! Per thread structure holding the current memory block. */
@@ -51,6 +51,10 @@ namespace embree
       
       __forceinline PrimInfo (size_t num, BBox3f geomBounds, BBox3f centBounds) 
         : num(num), geomBounds(geomBounds), centBounds(centBounds) {}
+
+      /*! object splits add no references, so there is no budget to pass on */
+      __forceinline PrimInfo (size_t num, BBox3f geomBounds, BBox3f centBounds, atomic_t /*budget*/) 
+        : num(num), geomBounds(geomBounds), centBounds(centBounds) {}
       
       /*! returns the number of primitives */
       __forceinline size_t size() const { 
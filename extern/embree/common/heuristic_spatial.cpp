@@ -18,6 +18,8 @@
 
 namespace embree
 {
+  float spatialSplitBudget = 1.0f;
+
   template<int logBlockSize>
   const size_t HeuristicSpatial<logBlockSize>::maxBins;
 
@@ -27,9 +29,7 @@ namespace embree
   template<int logBlockSize>
   const float HeuristicSpatial<logBlockSize>::rightSplitPos = 0.49f;
   
-  template<int logBlockSize>
-  __forceinline std::pair<PrimRef,PrimRef> HeuristicSpatial<logBlockSize>::splitPrimRef(const PrimRef& prim, int dim, float pos,
-                                                                                        const BuildTriangle* triangles, const Vec3fa* vertices)
+  std::pair<PrimRef,PrimRef> splitPrimRef(const PrimRef& prim, int dim, float pos, const BuildTriangle* triangles, const Vec3fa* vertices)
   {
     std::pair<BBox3f,BBox3f> pair(empty,empty);
     const BuildTriangle& tri = triangles[prim.id()];
@@ -77,6 +77,9 @@ namespace embree
       const int b0 = bin.x; counts[b0][0]++; geomBounds[b0][0].grow(prim); centBounds[b0][0].grow(center);
       const int b1 = bin.y; counts[b1][1]++; geomBounds[b1][1].grow(prim); centBounds[b1][1].grow(center);
       const int b2 = bin.z; counts[b2][2]++; geomBounds[b2][2].grow(prim); centBounds[b2][2].grow(center);
+
+      /*! skip clipping once no spatial split could be afforded anymore */
+      if (unlikely(!spatial)) continue;
       
       /*! calculate for each dimension if primitive goes to the left and right for spatial splits */
       const Vec3b left  = mapping.left (prim);
@@ -115,6 +118,7 @@ namespace embree
   void HeuristicSpatial<logBlockSize>::best_spatial_split(Split& split)
   {
     /* find best spatial split */
+    if (unlikely(!spatial)) return;
     for (int i=0; i<3; i++) 
     {
       size_t numFailed = pinfo.numFailed + (size_t(lcounts[i]) == pinfo.num && size_t(rcounts[i]) == pinfo.num);
@@ -259,6 +263,7 @@ namespace embree
         }
       }
 
+      binner_o.spatial &= binner.spatial;
       binner_o.lcounts += binner.lcounts;
       binner_o.rcounts += binner.rcounts;
       for (size_t dim=0; dim<3; dim++) 
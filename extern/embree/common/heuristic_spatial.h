@@ -22,6 +22,17 @@
 
 namespace embree
 {
+  /*! Maximal number of additional triangle references spatial splits
+   *  and early splits may create, as a fraction of the number of input
+   *  triangles. Once exhausted, the builder only performs object
+   *  splits. */
+  extern float spatialSplitBudget;
+
+  /*! Clipping code. Splits the triangle of a build primitive with a
+   *  clipping plane and returns the bounds of both halves clamped to
+   *  the bounds of the primitive. */
+  std::pair<PrimRef,PrimRef> splitPrimRef(const PrimRef& ref, int dim, float pos, const BuildTriangle* triangles, const Vec3fa* vertices);
+
   /* Single threaded combined object and spatial binner. Performs the
    * same object binning procedure as the HeuristicBinning class. In
    * addition tries spatial splits, by splitting each dimension
@@ -38,18 +49,12 @@ namespace embree
     /*! Maximal number of times a spatial split is allowed to fail. */
     static const size_t maxFailed = 2;
 
-    /*! Maximal amount of triangle duplications allowed */
-    static const size_t duplicationPercentage = 100;  //!< up to 100% additional triangles allowed
-    
     /*! Primitives whose right bound is smaller go to the left size. */
     static const float leftSplitPos;
     
     /*! Primitives whose left bound is larger go to the right size. */
     static const float rightSplitPos;
 
-    /*! Clipping code. Splits a triangle with a clipping plane into two halves. */
-    static std::pair<PrimRef,PrimRef> splitPrimRef(const PrimRef& ref, int dim, float pos, const BuildTriangle* triangles, const Vec3fa* vertices);
-
   public:
 
     /*! We build the tree breadth first to better distribute triangle duplications over scene. */
@@ -65,13 +70,19 @@ namespace embree
       __forceinline PrimInfo (size_t num, BBox3f geomBounds) 
         : num(num), numFailed(0), geomBounds(geomBounds), centBounds(geomBounds) 
       {
-        duplications = new Atomic(size_t(duplicationPercentage*double(num)/100.0));
+        duplications = new Atomic(atomic_t(spatialSplitBudget*double(num)));
       }
       
       __forceinline PrimInfo (size_t num, BBox3f geomBounds, BBox3f centBounds)
         : num(num), numFailed(0), geomBounds(geomBounds), centBounds(centBounds) 
       {
-        duplications = new Atomic(size_t(duplicationPercentage*double(num)/100.0));
+        duplications = new Atomic(atomic_t(spatialSplitBudget*double(num)));
+      }
+
+      __forceinline PrimInfo (size_t num, BBox3f geomBounds, BBox3f centBounds, atomic_t budget)
+        : num(num), numFailed(0), geomBounds(geomBounds), centBounds(centBounds) 
+      {
+        duplications = new Atomic(budget);
       }
 
       __forceinline PrimInfo (size_t num, int numFailed, BBox3f geomBounds, BBox3f centBounds, Atomic* duplications) 
@@ -254,7 +265,7 @@ namespace embree
     
     /*! construction from geometry info */
     __forceinline HeuristicSpatial(const PrimInfo& pinfo, const BuildTriangle* triangles, const Vec3fa* vertices)
-      : pinfo(pinfo), mapping(pinfo), triangles(triangles), vertices(vertices) { clear(); }
+      : pinfo(pinfo), mapping(pinfo), spatial(*pinfo.duplications > 0), triangles(triangles), vertices(vertices) { clear(); }
 
     /*! clear the binner */
     __forceinline void clear()
@@ -304,6 +315,7 @@ namespace embree
   public:
     PrimInfo pinfo;                 //!< bounding information of geometry
     Mapping mapping;                //!< mapping from geometry to the bins
+    bool spatial;                   //!< false if the duplication budget was exhausted and only object splits are binned
     
     /* counter and bounds for object binning */
   public:
@@ -36,12 +36,13 @@ namespace embree
     float u;           //!< Barycentric u coordinate of hit
     float v;           //!< Barycentric v coordinate of hit
     float t;           //!< Distance of hit
+    Vec3f Ng;          //!< Unnormalized geometry normal cross(v0-v1,v2-v0) of the hit triangle
   };
 
   /*! Outputs hit to to stream. */
   inline std::ostream& operator<<(std::ostream& cout, const Hit& hit) {
     return cout << "{ id0 = " << hit.id0 << ", id1 = " << hit.id1 <<  ", "
-                << "u = " << hit.u <<  ", v = " << hit.v <<  ", t = " << hit.t << " }";
+                << "u = " << hit.u <<  ", v = " << hit.v <<  ", t = " << hit.t <<  ", Ng = " << hit.Ng << " }";
   }
 }
 
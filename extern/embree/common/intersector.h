@@ -22,6 +22,21 @@
 
 namespace embree
 {
+  class Intersector;
+
+  /*! Caller owned record of the primitive that last occluded a
+   *  ray. Shadow rays cast from nearby points towards the same light
+   *  tend to be blocked by the same geometry, so traversers test this
+   *  primitive before descending the hierarchy. A cache must only be
+   *  used with one thread at a time. */
+  struct OcclusionCache
+  {
+    OcclusionCache () : owner(NULL), prim(NULL) {}
+
+    const Intersector* owner;  //!< intersector the cached primitive belongs to
+    const void* prim;          //!< primitive that last occluded a ray
+  };
+
   /*! Single ray interface to the traverser. A closest intersection
    *  point of a ray with the geometry can be found. A ray can also be
    *  tested for occlusion by any geometry. */
@@ -41,6 +56,14 @@ namespace embree
 
     /*! Tests the ray for occlusion with the scene. */
     virtual bool occluded (const Ray& ray    /*!< Ray to test occlusion for. */) const = 0;
+
+    /*! Tests the ray for occlusion with the scene, trying the
+     *  primitive in the cache first and storing the occluder found
+     *  in it. */
+    virtual bool occluded (const Ray& ray,        /*!< Ray to test occlusion for. */
+                           OcclusionCache& /*cache*/  /*!< Last occluder of this caller. */) const {
+      return occluded(ray);
+    }
   };
 }
 
@@ -19,6 +19,11 @@
 
 namespace embree
 {
+  float earlySplitThreshold = 0.0f;
+
+  template<typename Heuristic, typename PrimRefBlockList>
+  const float PrimRefGen<Heuristic,PrimRefBlockList>::maxEarlySplitCoverage = 0.25f;
+
   template<typename Heuristic, typename PrimRefBlockList>
   PrimRefGen<Heuristic,PrimRefBlockList>::PrimRefGen(const TaskScheduler::ThreadInfo& thread,
                                                      const BuildTriangle* triangles, size_t numTriangles, 
@@ -38,6 +43,10 @@ namespace embree
     }
     else
       new (&pinfo) PrimInfo(numTriangles,bounds);
+
+    /* early splitting is relative to the scene size */
+    earlySplitArea = earlySplitThreshold > 0.0f ? earlySplitThreshold*halfArea(pinfo.geomBounds) : float(inf);
+    earlySplits = atomic_t(spatialSplitBudget*double(numTriangles));
     
     /* start parallel task */
     scheduler->addTask(thread,TaskScheduler::GLOBAL_FRONT,
@@ -64,6 +73,60 @@ namespace embree
     return PrimRef(b,i);
   }
 
+  template<typename Heuristic, typename PrimRefBlockList>
+  __forceinline bool PrimRefGen<Heuristic,PrimRefBlockList>::splitEarly(const PrimRef& prim) const
+  {
+    if (likely(halfArea(prim.bounds()) <= earlySplitArea)) return false;
+
+    /* moving triangles have no static bounds to clip */
+    const BuildTriangle& tri = triangles[prim.id()];
+    if (tri.id0 & 0x80000000) return false;
+
+    /* triangles filling most of their bounds gain little from tighter boxes */
+    const Vec3f v0 = vertices[tri.v0];
+    const Vec3f v1 = vertices[tri.v1];
+    const Vec3f v2 = vertices[tri.v2];
+    const float triArea = 0.5f*length(cross(v1-v0,v2-v0));
+    return triArea < maxEarlySplitCoverage*halfArea(prim.bounds());
+  }
+
+  template<typename Heuristic, typename PrimRefBlockList>
+  size_t PrimRefGen<Heuristic,PrimRefBlockList>::earlySplit(const TaskScheduler::ThreadInfo& thread, Heuristic& heuristic, 
+                                                            typename PrimRefBlockList::item*& block, 
+                                                            const PrimRef& prim, size_t depth, BBox3f& centBound)
+  {
+    const BBox3f b = prim.bounds();
+    bool split = depth < maxEarlySplitDepth && halfArea(b) > earlySplitArea;
+
+    /* each halving adds a reference */
+    if (split && earlySplits.sub(1) < 0) {
+      earlySplits.add(1);
+      split = false;
+    }
+
+    if (!split) {
+      centBound.grow(center2(b));
+      insert(thread,heuristic,block,prim);
+      return 1;
+    }
+
+    /* halve the primitive along its largest extent, the triangle spans the box so both halves are non-empty */
+    const int dim = maxDim(b.size());
+    const std::pair<PrimRef,PrimRef> pair = splitPrimRef(prim,dim,0.5f*(b.lower[dim]+b.upper[dim]),triangles,vertices);
+    return earlySplit(thread,heuristic,block,pair.first ,depth+1,centBound) + 
+           earlySplit(thread,heuristic,block,pair.second,depth+1,centBound);
+  }
+
+  template<typename Heuristic, typename PrimRefBlockList>
+  __forceinline void PrimRefGen<Heuristic,PrimRefBlockList>::insert(const TaskScheduler::ThreadInfo& thread, Heuristic& heuristic, 
+                                                                    typename PrimRefBlockList::item*& block, const PrimRef& prim)
+  {
+    if (likely(block->insert(prim))) return;
+    heuristic.bin(block->base(),block->size());
+    block = prims.insert(alloc->malloc(thread));
+    block->insert(prim);
+  }
+
   template<typename Heuristic, typename PrimRefBlockList>
   void PrimRefGen<Heuristic,PrimRefBlockList>::task_gen_parallel(const TaskScheduler::ThreadInfo& thread, size_t idx) 
   {
@@ -74,19 +137,25 @@ namespace embree
     size_t start = (idx+0)*numTriangles/numTasks;
     size_t end   = (idx+1)*numTriangles/numTasks;
     BBox3f geomBound = empty, centBound = empty;
+    size_t num = 0;
     typename PrimRefBlockList::item* block = prims.insert(alloc->malloc(thread)); 
     
     for (size_t i=start; i<end; i++) 
     {
-      const PrimRef prim = MakePrimRef(i,geomBound,centBound);
-      if (likely(block->insert(prim))) continue; 
-      heuristic.bin(block->base(),block->size());
-      block = prims.insert(alloc->malloc(thread));
-      block->insert(prim);
+      BBox3f primCentBound = empty;
+      const PrimRef prim = MakePrimRef(i,geomBound,primCentBound);
+      if (unlikely(splitEarly(prim))) {
+        num += earlySplit(thread,heuristic,block,prim,0,centBound);
+        continue;
+      }
+      centBound.grow(primCentBound);
+      insert(thread,heuristic,block,prim);
+      num++;
     }
     heuristic.bin(block->base(),block->size());
     geomBounds[idx] = geomBound;
     centBounds[idx] = centBound;
+    numPrims[idx] = num;
   }
   
   template<typename Heuristic, typename PrimRefBlockList>
@@ -95,11 +164,13 @@ namespace embree
     /* reduce geometry and centroid bounds */
     BBox3f geomBound = empty;
     BBox3f centBound = empty;
+    size_t num = 0;
     for (size_t i=0; i<numTasks; i++) {
       geomBound = merge(geomBound,geomBounds[i]);
       centBound = merge(centBound,centBounds[i]);
+      num += numPrims[i];
     }
-    new (&pinfo) PrimInfo(numTriangles,geomBound,centBound);
+    new (&pinfo) PrimInfo(num,geomBound,centBound,earlySplits);
     
     /* reduce heuristic and find best split */
     Heuristic heuristic; 
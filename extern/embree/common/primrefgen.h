@@ -23,11 +23,24 @@
 
 namespace embree
 {
+  /*! Triangles whose bounds exceed this fraction of the surface area
+   *  of the scene bounds are split into several build primitives
+   *  before binning, as long as the spatial split budget lasts. Zero
+   *  disables early splitting. */
+  extern float earlySplitThreshold;
+
   /*! Generates a list of build primitives from a list of triangles. */
   template<typename Heuristic, typename PrimRefBlockList>      
     class PrimRefGen
   {
     static const size_t numTasks = 40;
+
+    /*! Maximal number of times a triangle is halved by early splitting. */
+    static const size_t maxEarlySplitDepth = 4;
+
+    /*! Only triangles covering less than this fraction of the surface area of their bounds are split early. */
+    static const float maxEarlySplitCoverage;
+
     typedef typename Heuristic::Split Split;
     typedef typename Heuristic::PrimInfo PrimInfo;
     
@@ -48,6 +61,16 @@ namespace embree
     /*! creates a build primitive from a triangle */
     PrimRef MakePrimRef(size_t i, BBox3f& geomBound, BBox3f& centBound);
 
+    /*! tests if a triangle is large and diagonal enough to get split early */
+    bool splitEarly(const PrimRef& prim) const;
+
+    /*! recursively halves a build primitive and adds the parts, returns the number of parts */
+    size_t earlySplit(const TaskScheduler::ThreadInfo& thread, Heuristic& heuristic, typename PrimRefBlockList::item*& block,
+                      const PrimRef& prim, size_t depth, BBox3f& centBound);
+
+    /*! adds a build primitive, binning the current block once it is full */
+    void insert(const TaskScheduler::ThreadInfo& thread, Heuristic& heuristic, typename PrimRefBlockList::item*& block, const PrimRef& prim);
+
     /*! parallel task to iterate over the triangles */
     void task_gen_parallel(const TaskScheduler::ThreadInfo& thread, size_t elt); 
     static void _task_gen_parallel(const TaskScheduler::ThreadInfo& thread, PrimRefGen* This, size_t elt) { This->task_gen_parallel(thread,elt); }
@@ -63,11 +86,14 @@ namespace embree
     const Vec3fa* vertices;          //!< array of input vertices
     size_t numVertices;              //!< number of vertices
     PrimRefAlloc* alloc;             //!< allocator for build primitive blocks
+    float earlySplitArea;            //!< build primitives with larger surface area get split early
+    Atomic earlySplits;              //!< references splitting may still add, spatial splits get what is left
     
     /* intermediate data */
   private:
     BBox3f geomBounds[numTasks];     //!< Geometry bounds per thread
     BBox3f centBounds[numTasks];     //!< Centroid bounds per thread
+    size_t numPrims[numTasks];       //!< Number of build primitives per thread
     Heuristic heuristics[numTasks];  //!< Heuristics per thread
     
     /* output data */
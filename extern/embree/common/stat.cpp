@@ -10,6 +10,7 @@
 
 namespace embree
 {
+  __thread Stat::Counters* Stat::local = NULL;
   Stat Stat::instance;
 
   Stat::Stat () {
@@ -22,9 +23,34 @@ namespace embree
 #endif
   }
 
+  Stat::Counters* Stat::registerThread()
+  {
+    /* counters outlive their thread so that its statistics still get summed */
+    Counters* cntrs = new (alignedMalloc(sizeof(Counters),64)) Counters;
+    Lock<MutexSys> lock(instance.mutex);
+    instance.threads.push_back(cntrs);
+    return cntrs;
+  }
+
+  Stat::Counters Stat::sum()
+  {
+    Counters total;
+    Lock<MutexSys> lock(instance.mutex);
+    for (size_t i=0; i<instance.threads.size(); i++)
+      total += *instance.threads[i];
+    return total;
+  }
+
+  void Stat::clear()
+  {
+    Lock<MutexSys> lock(instance.mutex);
+    for (size_t i=0; i<instance.threads.size(); i++)
+      instance.threads[i]->clear();
+  }
+
   void Stat::print(std::ostream& cout)
   {
-    Counters& cntrs = instance.cntrs;
+    const Counters cntrs = sum();
 
     /* print absolute numbers */
     cout << "--------- ABSOLUTE ---------" << std::endl;
@@ -37,6 +63,8 @@ namespace embree
       cout << "    #nodes      = " << float(cntrs.code.shadow.trav_nodes )*1E-6 << "M" << std::endl;
       cout << "    #leaves     = " << float(cntrs.code.shadow.trav_leaves)*1E-6 << "M" << std::endl;
       cout << "    #tris       = " << float(cntrs.code.shadow.trav_tris  )*1E-6 << "M" << std::endl;
+      cout << "    #early_outs = " << float(cntrs.code.shadow.trav_early_outs)*1E-6 << "M" << std::endl;
+      cout << "    #cache_hits = " << float(cntrs.code.shadow.trav_cache_hits)*1E-6 << "M" << std::endl;
     }
     cout << std::endl;
 
@@ -59,6 +87,8 @@ namespace embree
       cout << "    #nodes      = " << float(cntrs.all.shadow.trav_nodes )/float(cntrs.all.shadow.travs) << ", " << 100.0f*active_shadow_trav_nodes  << "% active" << std::endl;
       cout << "    #leaves     = " << float(cntrs.all.shadow.trav_leaves)/float(cntrs.all.shadow.travs) << ", " << 100.0f*active_shadow_trav_leaves << "% active" << std::endl;
       cout << "    #tris       = " << float(cntrs.all.shadow.trav_tris  )/float(cntrs.all.shadow.travs) << ", " << 100.0f*active_shadow_trav_tris   << "% active" << std::endl;
+      cout << "    #early_outs = " << float(cntrs.all.shadow.trav_early_outs)/float(cntrs.all.shadow.travs) << std::endl;
+      cout << "    #cache_hits = " << float(cntrs.all.shadow.trav_cache_hits)/float(cntrs.all.shadow.travs) << std::endl;
     }
     cout << std::endl;
   }
@@ -10,14 +10,21 @@
 #define __EMBREE_STAT_H__
 
 #include "default.h"
+#include "../sys/sync/mutex.h"
 
-/* Makros to gather statistics */
-#ifdef __USE_STAT_COUNTERS__
+#include <vector>
+
+/* Makros to gather statistics. The counters are per thread and
+ * cheap enough to stay enabled, define __NO_STAT_COUNTERS__ to
+ * compile them out. */
+#ifndef __NO_STAT_COUNTERS__
 #define STAT(x) x
-#define STAT3(s,x,y,z) \
-  STAT(Stat::get().code  .s+=x);               \
-  STAT(Stat::get().active.s+=y);               \
-  STAT(Stat::get().all   .s+=z);
+#define STAT3(s,x,y,z) {                       \
+  Stat::Counters& statCounters = Stat::get();  \
+  statCounters.code  .s+=x;                    \
+  statCounters.active.s+=y;                    \
+  statCounters.all   .s+=z;                    \
+}
 #else
 #define STAT(x)
 #define STAT3(s,x,y,z)
@@ -25,7 +32,8 @@
 
 namespace embree
 {
-  /*! Gathers ray tracing statistics. */
+  /*! Gathers ray tracing statistics. Every thread increments its
+   *  own cache line aligned counters, which are summed on demand. */
   class Stat
   { 
   public:
@@ -33,7 +41,7 @@ namespace embree
     Stat ();
     ~Stat ();
 
-    class Counters 
+    class __emb_align(64) Counters 
     {
     public:
       Counters () { 
@@ -44,6 +52,16 @@ namespace embree
         memset(this,0,sizeof(Counters)); 
       }
 
+      Counters& operator+=(const Counters& other) {
+        for (size_t i=0; i<sizeof(data)/sizeof(data[0]); i++) data[i] += other.data[i];
+        return *this;
+      }
+
+      Counters& operator-=(const Counters& other) {
+        for (size_t i=0; i<sizeof(data)/sizeof(data[0]); i++) data[i] -= other.data[i];
+        return *this;
+      }
+
     public:
 
       union {
@@ -58,30 +76,40 @@ namespace embree
               size_t trav_nodes;
               size_t trav_leaves;
               size_t trav_tris;
+              size_t trav_early_outs;  //!< traversals terminated by the first hit found
+              size_t trav_cache_hits;  //!< traversals answered by the cached last occluder
             } normal, shadow;
           } all, active, code;
         };
 
-        size_t data[32];
+        size_t data[48];
       };
     };
 
   public:
 
+    /*! returns the counters of the calling thread */
     static __forceinline Counters& get() {
-      return instance.cntrs;
+      if (unlikely(local == NULL)) local = registerThread();
+      return *local;
     }
     
-    static void clear() {
-      instance.cntrs.clear();
-    }
+    /*! returns the sum of the counters of all threads */
+    static Counters sum();
+
+    /*! clears the counters of all threads */
+    static void clear();
     
     static void print(std::ostream& cout);
 
-  private: 
-    Counters cntrs;
   private:
+    static Counters* registerThread();
+
+  private:
+    static __thread Counters* local;
     static Stat instance;
+    MutexSys mutex;
+    std::vector<Counters*> threads;
   };
 }
 
@@ -39,6 +39,27 @@ namespace embree
     VirtualFree(ptr,bytes,MEM_RELEASE);
   }
 
+  void* os_malloc_pages(size_t bytes, bool huge) 
+  {
+    /* large pages need the lock pages privilege, which most users lack */
+    if (huge && GetLargePageMinimum()) {
+      const size_t large = GetLargePageMinimum();
+      char* ptr = (char*) VirtualAlloc(NULL,(bytes+large-1)/large*large,MEM_COMMIT|MEM_RESERVE|MEM_LARGE_PAGES,PAGE_READWRITE);
+      if (ptr) return ptr;
+    }
+    char* ptr = (char*) VirtualAlloc(NULL,bytes,MEM_COMMIT|MEM_RESERVE,PAGE_READWRITE);
+    if (ptr == NULL) throw std::runtime_error("memory allocation failed");
+    return ptr;
+  }
+
+  void os_free_pages(void* ptr, size_t bytes) {
+    VirtualFree(ptr,0,MEM_RELEASE);
+  }
+
+  bool os_advise_huge_pages(void* ptr, size_t bytes) {
+    return false;
+  }
+
   double getSeconds() {
     LARGE_INTEGER freq, val;
     QueryPerformanceFrequency(&freq);
@@ -71,6 +92,47 @@ namespace embree
     munmap(ptr,bytes);
   }
 
+  void* os_malloc_pages(size_t bytes, bool huge) 
+  {
+    if (!huge) {
+      void* ptr = mmap(0, bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+      if (ptr == MAP_FAILED) throw std::runtime_error("memory allocation failed");
+      return ptr;
+    }
+    bytes = (bytes+hugePageSize-1) & ~(hugePageSize-1);
+
+#if defined(MAP_HUGETLB)
+    /* explicit huge pages are reserved when mapped, so this fails instead of faulting later */
+    void* ptr = mmap(0, bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON|MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) return ptr;
+#endif
+
+    /* over-allocate by one huge page and trim to an aligned range */
+    char* base = (char*) mmap(0, bytes+hugePageSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+    if (base == MAP_FAILED) throw std::runtime_error("memory allocation failed");
+    char* aligned = (char*)(((size_t)base+hugePageSize-1) & ~(hugePageSize-1));
+    if (aligned > base) munmap(base,aligned-base);
+    if (aligned+bytes < base+bytes+hugePageSize) munmap(aligned+bytes,base+bytes+hugePageSize-(aligned+bytes));
+    os_advise_huge_pages(aligned,bytes);
+    return aligned;
+  }
+
+  void os_free_pages(void* ptr, size_t bytes) {
+    munmap(ptr,bytes);
+  }
+
+  bool os_advise_huge_pages(void* ptr, size_t bytes) 
+  {
+#if defined(MADV_HUGEPAGE)
+    char* begin = (char*)(((size_t)ptr+hugePageSize-1) & ~(hugePageSize-1));
+    char* end   = (char*)(((size_t)ptr+bytes) & ~(hugePageSize-1));
+    if (end <= begin) return false;
+    return madvise(begin,end-begin,MADV_HUGEPAGE) == 0;
+#else
+    return false;
+#endif
+  }
+
   double getSeconds() {
     struct timeval tp; gettimeofday(&tp,NULL);
     return double(tp.tv_sec) + double(tp.tv_usec)/1E6;
@@ -243,6 +243,21 @@ namespace embree
   void* os_malloc(size_t bytes);
   void os_free(void* ptr, size_t bytes);
 
+  /*! size of the huge pages os_malloc_pages and os_advise_huge_pages use */
+  static const size_t hugePageSize = 2*1024*1024;
+
+  /*! allocates pages directly from OS without touching them. With huge
+   *  set, the allocation is rounded up to and aligned at hugePageSize
+   *  and backed by explicit huge pages if the system reserved some, by
+   *  transparent huge pages otherwise, and by normal pages if neither
+   *  is available. Sizes should be multiples of hugePageSize then. */
+  void* os_malloc_pages(size_t bytes, bool huge);
+  void os_free_pages(void* ptr, size_t bytes);
+
+  /*! asks OS to back the hugePageSize aligned part of a range by
+   *  transparent huge pages, returns false if it does not support them */
+  bool os_advise_huge_pages(void* ptr, size_t bytes);
+
   /*! returns performance counter in seconds */
   double getSeconds();
 }
@@ -17,6 +17,8 @@
 #include "sysinfo.h"
 #include "intrinsics.h"
 
+#include <vector>
+
 ////////////////////////////////////////////////////////////////////////////////
 /// All Platforms
 ////////////////////////////////////////////////////////////////////////////////
@@ -121,6 +123,37 @@ namespace embree
 #endif
   }
 
+  /*! lists the ids of the nodes with logical threads */
+  static std::vector<size_t> getNumaNodeIDs()
+  {
+    std::vector<size_t> ids;
+    ULONG highest = 0;
+    if (!GetNumaHighestNodeNumber(&highest)) return ids;
+    for (ULONG i=0; i<=highest; i++) {
+      ULONGLONG mask = 0;
+      if (GetNumaNodeProcessorMask((UCHAR)i,&mask) && mask) ids.push_back(i);
+    }
+    return ids;
+  }
+
+  size_t getNumberOfNumaNodes() {
+    const size_t nodes = getNumaNodeIDs().size();
+    return nodes ? nodes : 1;
+  }
+
+  size_t getNumaNodeID(size_t node) {
+    const std::vector<size_t> ids = getNumaNodeIDs();
+    return node < ids.size() ? ids[node] : node;
+  }
+
+  size_t getPhysicalMemory() 
+  {
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status)) return 0;
+    return size_t(status.ullTotalPhys);
+  }
+
   int getTerminalWidth() 
   {
     HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
@@ -129,6 +162,10 @@ namespace embree
     GetConsoleScreenBufferInfo(handle, &info);
     return info.dwSize.X;
   }
+
+  size_t getHugePageMemory() {
+    return 0;
+  }
 }
 #endif
 
@@ -151,6 +188,63 @@ namespace embree
     if (bytes != -1) buf[bytes] = '\0';
     return std::string(buf);
   }
+
+  /*! lists the ids of the online nodes with logical threads */
+  static std::vector<size_t> getNumaNodeIDs()
+  {
+    /* the list holds ranges like 0-1,4 */
+    std::vector<size_t> ids;
+    FILE* file = fopen("/sys/devices/system/node/has_cpu","r");
+    if (!file) return ids;
+    unsigned first = 0, last = 0;
+    char sep = 0;
+    while (true) {
+      int n = fscanf(file,"%u%c",&first,&sep);
+      if (n < 1) break;
+      last = first;
+      if (n == 2 && sep == '-' && fscanf(file,"%u%c",&last,&sep) < 1) break;
+      for (unsigned i=first; i<=last; i++) ids.push_back(i);
+      if (n < 2 || sep != ',') break;
+    }
+    fclose(file);
+    return ids;
+  }
+
+  size_t getNumberOfNumaNodes() {
+    const size_t nodes = getNumaNodeIDs().size();
+    return nodes ? nodes : 1;
+  }
+
+  size_t getNumaNodeID(size_t node) {
+    const std::vector<size_t> ids = getNumaNodeIDs();
+    return node < ids.size() ? ids[node] : node;
+  }
+
+  size_t getPhysicalMemory() 
+  {
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || pageSize <= 0) return 0;
+    return size_t(pages)*size_t(pageSize);
+  }
+
+  size_t getHugePageMemory() 
+  {
+    /* sum the transparent and explicit huge pages over all mappings */
+    FILE* file = fopen("/proc/self/smaps","r");
+    if (!file) return 0;
+    size_t kB = 0;
+    char line[256];
+    while (fgets(line,sizeof(line),file)) {
+      unsigned long n = 0;
+      if (sscanf(line,"AnonHugePages: %lu kB",&n) == 1 ||
+          sscanf(line,"Private_Hugetlb: %lu kB",&n) == 1 ||
+          sscanf(line,"Shared_Hugetlb: %lu kB",&n) == 1)
+        kB += n;
+    }
+    fclose(file);
+    return kB*1024;
+  }
 }
 
 #endif
@@ -162,6 +256,7 @@ namespace embree
 #ifdef __MACOSX__
 
 #include <mach-o/dyld.h>
+#include <sys/sysctl.h>
 
 namespace embree
 {
@@ -172,6 +267,26 @@ namespace embree
     if (_NSGetExecutablePath(buf, &size) != 0) return std::string();
     return std::string(buf);
   }
+
+  size_t getHugePageMemory() {
+    return 0;
+  }
+
+  size_t getNumberOfNumaNodes() {
+    return 1;
+  }
+
+  size_t getNumaNodeID(size_t node) {
+    return node;
+  }
+
+  size_t getPhysicalMemory() 
+  {
+    uint64_t bytes = 0;
+    size_t size = sizeof(bytes);
+    if (sysctlbyname("hw.memsize",&bytes,&size,NULL,0) != 0) return 0;
+    return size_t(bytes);
+  }
 }
 
 #endif
@@ -43,9 +43,24 @@ namespace embree
 
   /*! return the number of logical threads of the system */
   size_t getNumberOfLogicalThreads();
+
+  /*! return the number of NUMA nodes with logical threads, 1 where unknown */
+  size_t getNumberOfNumaNodes();
+
+  /*! return the system id of the given one of these NUMA nodes, ids
+   *  skip nodes that are offline or have no logical threads */
+  size_t getNumaNodeID(size_t node);
+
+  /*! return the bytes of physical memory of the system, or zero where
+   *  this is unknown */
+  size_t getPhysicalMemory();
   
   /*! returns the size of the terminal window in characters */
   int getTerminalWidth();
+
+  /*! returns the number of bytes of this process that are backed by
+   *  huge pages, or zero where this is unknown */
+  size_t getHugePageMemory();
 }
 
 #endif
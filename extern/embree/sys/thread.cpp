@@ -80,6 +80,21 @@ namespace embree
     setAffinity(GetCurrentThread(), affinity);
   }
 
+  /*! binds the calling thread to the logical threads of a NUMA node */
+  bool setNodeAffinity(size_t node)
+  {
+    const size_t id = getNumaNodeID(node);
+#if (_WIN32_WINNT >= 0x0601)
+    GROUP_AFFINITY groupAffinity;
+    if (!GetNumaNodeProcessorMaskEx((USHORT)id, &groupAffinity)) return false;
+    return SetThreadGroupAffinity(GetCurrentThread(), &groupAffinity, NULL) != 0;
+#else
+    ULONGLONG mask;
+    if (!GetNumaNodeProcessorMask((UCHAR)id, &mask)) return false;
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(mask)) != 0;
+#endif
+  }
+
   struct ThreadStartupData 
   {
   public:
@@ -168,6 +183,29 @@ namespace embree
     if (pthread_setaffinity_np(pthread_self(), sizeof(cset), &cset) != 0)
       std::cerr << "Thread: cannot set affinity" << std::endl;
   }
+
+  /*! binds the calling thread to the logical threads of a NUMA node */
+  bool setNodeAffinity(size_t node)
+  {
+    char path[64];
+    sprintf(path,"/sys/devices/system/node/node%d/cpulist",int(getNumaNodeID(node)));
+    FILE* file = fopen(path,"r");
+    if (!file) return false;
+
+    /* the list holds ranges like 0-7,16-23 */
+    cpu_set_t cset;
+    CPU_ZERO(&cset);
+    unsigned first, last; char sep = 0;
+    while (fscanf(file,"%u%c",&first,&sep) == 2) {
+      last = first;
+      if (sep == '-' && fscanf(file,"%u%c",&last,&sep) != 2) break;
+      for (unsigned i=first; i<=last && i<CPU_SETSIZE; i++) CPU_SET(i, &cset);
+      if (sep != ',') break;
+    }
+    fclose(file);
+
+    return CPU_COUNT(&cset) != 0 && pthread_setaffinity_np(pthread_self(), sizeof(cset), &cset) == 0;
+  }
 }
 #endif
 
@@ -191,6 +229,11 @@ namespace embree
     if (thread_policy_set(mach_thread_self(),THREAD_AFFINITY_POLICY,(integer_t*)&ap,THREAD_AFFINITY_POLICY_COUNT) != KERN_SUCCESS)
       std::cerr << "Thread: cannot set affinity" << std::endl;
   }
+
+  /*! NUMA nodes are not exposed, threads stay where the system puts them */
+  bool setNodeAffinity(size_t /*node*/) {
+    return false;
+  }
 }
 #endif
 
@@ -33,6 +33,10 @@ namespace embree
   /*! set affinity of the calling thread */
   void setAffinity(ssize_t affinity);
 
+  /*! binds the calling thread to the logical threads of the given one
+   *  of the getNumberOfNumaNodes() nodes, returns false where it can't */
+  bool setNodeAffinity(size_t node);
+
   /*! the thread calling this function gets yielded */
   void yield();
 
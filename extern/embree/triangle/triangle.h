@@ -32,6 +32,11 @@ namespace embree
     /*! Computes the number of blocks required to store a number of triangles. */
     virtual size_t blocks(size_t x) const = 0;
 
+    /*! Computes the number of blocks pack fills with the given x
+     *  triangles. Types whose blocks hold a varying number of triangles
+     *  return less than blocks(x) for most leaves. */
+    virtual size_t blocks(size_t x, atomic_set<PrimRefBlock>::block_iterator_unsafe /*prims*/, const BuildTriangle* /*triangles*/) const { return blocks(x); }
+
     /*! Returns the number of stored triangles. */
     virtual size_t size(const char* This) const = 0;
 
@@ -50,6 +55,11 @@ namespace embree
     bool   needVertices;    //!< determines if we need the vertex array
     int    intCost;         //!< cost of one ray/triangle intersection
   };
+
+  /*! Prefetches the vertices a triangle block references. Blocks that
+   *  store their own vertices have nothing to fetch. */
+  template<typename Triangle>
+  __forceinline void prefetchVertices(const Triangle& /*tri*/, const Vec3fa* /*vertices*/) {}
 }
 
 #endif
@@ -71,6 +71,7 @@ namespace embree
       hit.t   = T * rcpAbsDet;
       hit.id0 = tri.e1.a;
       hit.id1 = tri.e2.a;
+      hit.Ng  = tri.Ng;
     }
 
     /*! Test if the ray is occluded by one of the triangles. */
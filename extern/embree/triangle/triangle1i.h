@@ -92,6 +92,11 @@ namespace embree
     int32 id0;     //!< 1st user ID.
     int32 id1;     //!< 2nd user ID.
   };
+
+  /*! Prefetches the 3 vertices of the triangle. */
+  __forceinline void prefetchVertices(const Triangle1i& tri, const Vec3fa* vertices) {
+    prefetchL1(&vertices[tri.v0]); prefetchL1(&vertices[tri.v1]); prefetchL1(&vertices[tri.v2]);
+  }
 }
 
 #endif
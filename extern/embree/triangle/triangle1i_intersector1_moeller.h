@@ -74,6 +74,7 @@ namespace embree
       hit.t   = T * rcpAbsDet;
       hit.id0 = tri.id0;
       hit.id1 = tri.id1;
+      hit.Ng  = Ng;
     }
 
     /*! Test if the ray is occluded by one of the triangles. */
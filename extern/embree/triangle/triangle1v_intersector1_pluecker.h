@@ -72,6 +72,7 @@ namespace embree
       hit.t   = T * rcpAbsDet;
       hit.id0 = tri.v0.a;
       hit.id1 = tri.v1.a;
+      hit.Ng  = Ng;
     }
 
     /*! Test if the ray is occluded by one of the triangles. */
@@ -60,6 +60,7 @@ namespace embree
       hit.t   = T * rcpabsudirz;
       hit.id0 = tri.id0;
       hit.id1 = tri.id1;
+      hit.Ng  = Vec3f(tri.xfm.l.vx.z,tri.xfm.l.vy.z,tri.xfm.l.vz.z);
     }
 
     /*! Test if the ray is occluded by one of the triangles. */
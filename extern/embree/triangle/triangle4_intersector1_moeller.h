@@ -71,6 +71,7 @@ namespace embree
       hit.t   = t[i];
       hit.id0 = tri.id0[i];
       hit.id1 = tri.id1[i];
+      hit.Ng  = Vec3f(tri.Ng.x[i],tri.Ng.y[i],tri.Ng.z[i]);
     }
 
     /*! Test if the ray is occluded by one of the triangles. */
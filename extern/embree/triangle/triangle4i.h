@@ -155,6 +155,15 @@ namespace embree
     ssei id0;      //!< 1st user ID.
     ssei id1;      //!< 2nd user ID.
   };
+
+  /*! Prefetches the vertices of the valid triangles. */
+  __forceinline void prefetchVertices(const Triangle4i& tri, const Vec3fa* vertices) 
+  {
+    for (size_t i=0; i<4; i++) {
+      if (tri.id0[i] == -1) break;
+      prefetchL1(&vertices[tri.v0[i]]); prefetchL1(&vertices[tri.v1[i]]); prefetchL1(&vertices[tri.v2[i]]);
+    }
+  }
 }
 
 #endif
@@ -81,6 +81,7 @@ namespace embree
       hit.v = v[i];
       hit.id0 = tri.id0[i] & 0x7FFFFFFF;
       hit.id1 = tri.id1[i];
+      hit.Ng  = Vec3f(Ng.x[i],Ng.y[i],Ng.z[i]);
     }
 
     /*! Test if the ray is occluded by one of the triangles. */
@@ -0,0 +1,93 @@
+// ======================================================================== //
+// Copyright 2009-2012 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_ACCEL_TRIANGLE4W_INTERSECTOR1_WOOP_H__
+#define __EMBREE_ACCEL_TRIANGLE4W_INTERSECTOR1_WOOP_H__
+
+#include "triangle4w.h"
+#include "../common/ray.h"
+#include "../common/hit.h"
+
+namespace embree
+{
+  /*! Intersector for a single ray with 4 triangles. This intersector
+   *  implements the unit triangle test from the paper "Real Time Ray
+   *  Tracing of Dynamic Scenes on an FPGA Chip" by Woop et al. The ray
+   *  is transformed into the space of each triangle, where the hit
+   *  distance and barycentric coordinates take only dot products. */
+  struct Triangle4wIntersectorWoop
+  {
+    typedef Triangle4w Triangle;
+
+    /*! Intersect a ray with the 4 triangles and updates the hit. */
+    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle4w& tri, const Vec3fa* vertices)
+    {
+      STAT3(normal.trav_tris,1,1,1);
+
+      /* perform depth test in triangle space */
+      const sse3f O = sse3f(ray.org);
+      const sse3f D = sse3f(ray.dir);
+      const ssef Dw = dot(tri.w,D);
+      const ssef t = -(tri.dw+dot(tri.w,O))*rcp(Dw);
+      sseb valid = (t > ssef(ray.near)) & (t < ssef(hit.t));
+      if (unlikely(none(valid))) return;
+
+      /* perform edge tests */
+      const sse3f P = O+t*D;
+      const ssef u = tri.du+dot(tri.u,P);
+      const ssef v = tri.dv+dot(tri.v,P);
+      valid &= (u >= 0.0f) & (v >= 0.0f) & (u+v <= 1.0f);
+      if (unlikely(none(valid))) return;
+
+      /* update hit information, the geometry normal is the normal row
+       * scaled back by its squared length */
+      const size_t i = select_min(valid,t);
+      const Vec3f Nw(tri.w.x[i],tri.w.y[i],tri.w.z[i]);
+      hit.u   = u[i];
+      hit.v   = v[i];
+      hit.t   = t[i];
+      hit.id0 = tri.id0[i];
+      hit.id1 = tri.id1[i];
+      hit.Ng  = -Nw/dot(Nw,Nw);
+    }
+
+    /*! Test if the ray is occluded by one of the triangles. */
+    static __forceinline bool occluded(const Ray& ray, const Triangle4w& tri, const Vec3fa* vertices = NULL)
+    {
+      STAT3(shadow.trav_tris,1,1,1);
+
+      /* perform depth test in triangle space */
+      const sse3f O = sse3f(ray.org);
+      const sse3f D = sse3f(ray.dir);
+      const ssef Dw = dot(tri.w,D);
+      const ssef t = -(tri.dw+dot(tri.w,O))*rcp(Dw);
+      sseb valid = (t >= ssef(ray.near)) & (ssef(ray.far) >= t);
+      if (unlikely(none(valid))) return false;
+
+      /* perform edge tests */
+      const sse3f P = O+t*D;
+      const ssef u = tri.du+dot(tri.u,P);
+      const ssef v = tri.dv+dot(tri.v,P);
+      valid &= (u >= 0.0f) & (v >= 0.0f) & (u+v <= 1.0f);
+      if (unlikely(none(valid))) return false;
+
+      return true;
+    }
+  };
+}
+
+#endif
+
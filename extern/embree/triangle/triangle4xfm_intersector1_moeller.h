@@ -69,6 +69,7 @@ namespace embree
       hit.t   = t[i];
       hit.id0 = tri.id0[i];
       hit.id1 = tri.id1[i];
+      hit.Ng  = Vec3f(xfm.l.vx.z[i],xfm.l.vy.z[i],xfm.l.vz.z[i]);
     }
 
     /*! Test if the ray is occluded by one of the triangles. */
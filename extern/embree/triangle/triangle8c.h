@@ -0,0 +1,267 @@
+// ======================================================================== //
+// Copyright 2009-2012 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_ACCEL_TRIANGLE8C_H__
+#define __EMBREE_ACCEL_TRIANGLE8C_H__
+
+#include "triangle.h"
+
+namespace embree
+{
+  /*! Compressed representation for up to 8 triangles in two cache
+      lines. The triangles share a table of at most 9 vertices,
+      quantized to 16 bits relative to the bounds of the table, and
+      reference it with 8 bit indices. When all triangles of a block
+      belong to the same object, their face IDs are stored relative to
+      the smallest one, otherwise the block stores the IDs of up to 3
+      triangles. Triangles are added to a block while they fit, so a
+      block holds 3 triangles when they share no vertices, and 8 when
+      they form a patch of 2x2 quads. */
+  struct Triangle8c
+  {
+    /*! block size, a block holds at least 3 triangles, which bounds
+     *  the triangles of a leaf. The SAH instead prices leaves as blocks
+     *  of 8 triangles, since the triangles of small nodes mostly form
+     *  patches of the mesh that fill the blocks, and pricing blocks of
+     *  4 makes the build split into leaves that hold fewer triangles
+     *  per block and take about 50% more memory. */
+    static const size_t blockSize = 3;
+    static const size_t logBlockSize = 3;
+
+    /*! Tests if we need the vertex array. */
+    static const bool needVertices = false;
+
+    /*! Cost of ray/triangle intersection. */
+    static const int intCost = 2;
+
+    /*! maximal number of triangles and vertices of a block */
+    static const size_t maxTriangles = 8;
+    static const size_t maxVertices = 9;
+
+    /*! maximal number of triangles of a block that stores their IDs */
+    static const size_t maxExplicitIDs = 3;
+
+    /*! largest face ID offset from the smallest one of a block */
+    static const int maxFaceOffset = 0xFFFF;
+
+    /*! virtual interface to query information about the triangle type */
+    static const struct Type : public TriangleType
+    {
+      Type () : TriangleType("triangle8c",sizeof(Triangle8c),3,false,2) {}
+
+      size_t blocks(size_t x) const {
+        return (x+2)/3;
+      }
+
+      size_t blocks(size_t /*x*/, atomic_set<PrimRefBlock>::block_iterator_unsafe prims, const BuildTriangle* triangles) const {
+        return Triangle8c::blocks(prims,triangles);
+      }
+
+      size_t size(const char* This) const {
+        return ((Triangle8c*)This)->size();
+      }
+
+      float area(const char* This, const Vec3fa* vertices) const {
+        return ((Triangle8c*)This)->area(vertices);
+      }
+
+      void pack(char* This, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, const BuildTriangle* triangles, const Vec3fa* vertices) const {
+        ((Triangle8c*)This)->pack(prims,triangles,vertices);
+      }
+    } type;
+
+    /*! Collects the triangles of one block while they fit. */
+    struct Packer
+    {
+      __forceinline Packer () : num(0), numVertices(0), explicitIDs(false), id0(0), minID1(0), maxID1(0) {}
+
+      /*! Adds the triangle, unless the block is full or the
+       *  triangle's new vertices don't fit into the vertex table. A
+       *  triangle of another object, or too far in face ID, makes the
+       *  block store the IDs of each triangle, which only fits while
+       *  the block holds fewer than maxExplicitIDs triangles. */
+      __forceinline bool add(const BuildTriangle& tri)
+      {
+        const int triID0 = tri.id0 & 0x7FFFFFFF; // no support for motion blur
+        const bool shared = num == 0 || (triID0 == id0 && int64(max(maxID1,tri.id1))-int64(min(minID1,tri.id1)) <= maxFaceOffset);
+        const bool explicitTriIDs = explicitIDs || !shared;
+        if (num >= (explicitTriIDs ? maxExplicitIDs : maxTriangles)) return false;
+
+        const int v[3] = { tri.v0, tri.v1, tri.v2 };
+        uint8 corner[3];
+        size_t n = numVertices;
+        for (size_t k=0; k<3; k++) {
+          size_t j=0; while (j<n && vertexIDs[j] != v[k]) j++;
+          if (j == n) {
+            if (n == maxVertices) return false;
+            vertexIDs[n++] = v[k];
+          }
+          corner[k] = uint8(j);
+        }
+
+        for (size_t k=0; k<3; k++) index[k][num] = corner[k];
+        objectIDs[num] = triID0;
+        faceIDs[num] = tri.id1;
+        explicitIDs = explicitTriIDs;
+        if (num == 0) { id0 = triID0; minID1 = maxID1 = tri.id1; }
+        else { minID1 = min(minID1,tri.id1); maxID1 = max(maxID1,tri.id1); }
+        numVertices = n;
+        num++;
+        return true;
+      }
+
+    public:
+      size_t num;                         //!< number of triangles added
+      size_t numVertices;                 //!< number of vertices in the table
+      bool explicitIDs;                   //!< whether the triangles don't share their user IDs
+      int vertexIDs[maxVertices];         //!< indices of the table's vertices into the vertex array
+      uint8 index[3][maxTriangles];       //!< table index of each triangle corner
+      int objectIDs[maxTriangles];        //!< 1st user ID of each triangle
+      int faceIDs[maxTriangles];          //!< 2nd user ID of each triangle
+      int id0, minID1, maxID1;            //!< common 1st user ID and range of the 2nd user IDs
+    };
+
+  public:
+
+    /*! Default constructor. */
+    __forceinline Triangle8c () {}
+
+    /*! Computes the number of blocks pack fills with the given triangles. */
+    template<typename Iterator>
+    static __forceinline size_t blocks(Iterator prims, const BuildTriangle* triangles)
+    {
+      size_t blocks = 0;
+      while (prims) {
+        Packer packer;
+        while (prims && packer.add(triangles[(*prims).id()])) prims++;
+        blocks++;
+      }
+      return blocks;
+    }
+
+    /*! Returns a mask that tells which of the 4 triangles starting at i are valid. */
+    __forceinline sseb valid(size_t i) const { return ssei(step)+ssei(int(i)) < ssei(int(num)); }
+
+    /*! Returns the number of stored triangles. */
+    __forceinline size_t size() const { return num; }
+
+    /*! Returns the user IDs of triangle i. */
+    __forceinline int id0(size_t i) const { return explicitIDs ? ids[i][0] : common.id0; }
+    __forceinline int id1(size_t i) const { return explicitIDs ? ids[i][1] : common.id1+common.offset[i]; }
+
+    /*! Decompresses corner k of the 4 triangles starting at i. */
+    __forceinline sse3f vertex(size_t k, size_t i) const
+    {
+      const uint8* idx = &index[k][i];
+      const uint16* p0 = v[idx[0]], *p1 = v[idx[1]], *p2 = v[idx[2]], *p3 = v[idx[3]];
+      const ssef x = ssef(ssei(p0[0],p1[0],p2[0],p3[0]));
+      const ssef y = ssef(ssei(p0[1],p1[1],p2[1],p3[1]));
+      const ssef z = ssef(ssei(p0[2],p1[2],p2[2],p3[2]));
+      return sse3f(ssef(lower[0])+x*ssef(scale[0]),ssef(lower[1])+y*ssef(scale[1]),ssef(lower[2])+z*ssef(scale[2]));
+    }
+
+    /*! Computes the area of the triangle. */
+    __forceinline float area(const Vec3fa* /*vertices*/) const
+    {
+      float A = 0.0f;
+      for (size_t i=0; i<num; i+=4) {
+        const sse3f v0 = vertex(0,i), v1 = vertex(1,i), v2 = vertex(2,i);
+        A += reduce_add(select(valid(i),length(cross(v0-v1,v2-v0)),ssef(0.0f)));
+      }
+      return A;
+    }
+
+    /*! Packs the triangles taken from primitive list while they fit. */
+    template<typename Iterator>
+    __forceinline void pack(Iterator& prims, const BuildTriangle* triangles, const Vec3fa* vertices)
+    {
+      Packer packer;
+      while (prims && packer.add(triangles[(*prims).id()])) prims++;
+
+      /*! quantize the vertex table relative to its bounds, to the
+       *  nearest step. The step is rounded down until the largest one
+       *  decompresses inside the bounds, with or without a fused
+       *  multiply-add, so the vertices stay inside the node bounds. */
+      BBox3f bounds = empty;
+      for (size_t j=0; j<packer.numVertices; j++) bounds.grow(Vec3f(vertices[packer.vertexIDs[j]]));
+      const Vec3f extent = bounds.size();
+      for (size_t a=0; a<3; a++) {
+        lower[a] = bounds.lower[a];
+        scale[a] = extent[a]/float(0xFFFF);
+        while (double(lower[a])+double(0xFFFF)*double(scale[a]) > double(bounds.upper[a]))
+          scale[a] = nextafterf(scale[a],0.0f);
+      }
+      memset(v,0,sizeof(v));
+      for (size_t j=0; j<packer.numVertices; j++) {
+        const Vec3f p = vertices[packer.vertexIDs[j]];
+        for (size_t a=0; a<3; a++) {
+          if (extent[a] == 0.0f) continue;
+          const float q = floorf((p[a]-bounds.lower[a])/extent[a]*float(0xFFFF)+0.5f);
+          v[j][a] = uint16(clamp(q,0.0f,float(0xFFFF)));
+        }
+      }
+
+      /*! unused slots reference the first vertex */
+      memset(index,0,sizeof(index));
+      for (size_t k=0; k<3; k++)
+        for (size_t i=0; i<packer.num; i++)
+          index[k][i] = packer.index[k][i];
+
+      if (packer.explicitIDs) {
+        memset(ids,0,sizeof(ids));
+        for (size_t i=0; i<packer.num; i++) {
+          ids[i][0] = packer.objectIDs[i];
+          ids[i][1] = packer.faceIDs[i];
+        }
+      } else {
+        common.id0 = packer.id0;
+        common.id1 = packer.minID1;
+        for (size_t i=0; i<maxTriangles; i++)
+          common.offset[i] = i < packer.num ? uint16(packer.faceIDs[i]-packer.minID1) : 0;
+      }
+      num = uint8(packer.num);
+      explicitIDs = packer.explicitIDs;
+
+      assert(!explicitIDs || num <= maxExplicitIDs);
+      for (size_t i=0; i<num; i++) {
+        assert(id0(i) == packer.objectIDs[i]);
+        assert(id1(i) == packer.faceIDs[i]);
+      }
+    }
+
+  public:
+    float lower[3];                         //!< Lower corner of the vertex table's bounds.
+    float scale[3];                         //!< Size of one quantization step per axis.
+
+    /*! user IDs of triangles of the same object */
+    struct CommonIDs {
+      int id0;                              //!< 1st user ID of all triangles.
+      int id1;                              //!< Smallest 2nd user ID.
+      uint16 offset[maxTriangles];          //!< 2nd user ID of each triangle relative to id1.
+    };
+
+    union {
+      CommonIDs common;                     //!< User IDs shared by the triangles.
+      int ids[maxExplicitIDs][2];           //!< User IDs of each triangle.
+    };
+    uint8 index[3][maxTriangles];           //!< Vertex table index of each triangle corner.
+    uint16 v[maxVertices][3];               //!< Quantized vertex table.
+    uint8 num;                              //!< Number of stored triangles.
+    bool explicitIDs;                       //!< Whether the block stores the IDs of each triangle.
+  };
+}
+
+#endif
@@ -0,0 +1,127 @@
+// ======================================================================== //
+// Copyright 2009-2012 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_ACCEL_TRIANGLE8C_INTERSECTOR1_MOELLER_H__
+#define __EMBREE_ACCEL_TRIANGLE8C_INTERSECTOR1_MOELLER_H__
+
+#include "triangle8c.h"
+#include "../common/ray.h"
+#include "../common/hit.h"
+
+namespace embree
+{
+  /*! Intersector for a single ray with up to 8 compressed
+   *  triangles. The triangles are decompressed 4 at a time into SSE
+   *  registers and intersected with the Moeller Trumbore test. */
+  struct Triangle8cIntersectorMoellerTrumbore
+  {
+    typedef Triangle8c Triangle;
+
+    /*! Intersect a ray with the 4 triangles starting at i and updates the hit. */
+    static __forceinline void intersect4(const Ray& ray, Hit& hit, const Triangle8c& tri, size_t i)
+    {
+      /* decompress triangles */
+      const sse3f v0 = tri.vertex(0,i);
+      const sse3f e1 = v0-tri.vertex(1,i);
+      const sse3f e2 = tri.vertex(2,i)-v0;
+      const sse3f Ng = cross(e1,e2);
+
+      /* calculate determinant */
+      const sse3f O = sse3f(ray.org);
+      const sse3f D = sse3f(ray.dir);
+      const sse3f C = v0 - O;
+      const sse3f R = cross(D,C);
+      const ssef det = dot(Ng,D);
+      const ssef absDet = abs(det);
+      const ssef sgnDet = signmsk(det);
+
+      /* perform edge tests */
+      const ssef U = dot(R,e2) ^ sgnDet;
+      const ssef V = dot(R,e1) ^ sgnDet;
+      sseb valid = tri.valid(i) & (det != ssef(zero)) & (U >= 0.0f) & (V >= 0.0f) & (U+V<=absDet);
+      if (unlikely(none(valid))) return;
+
+      /* perform depth test */
+      const ssef T = dot(Ng,C) ^ sgnDet;
+      valid &= (T > absDet*ssef(ray.near)) & (T < absDet*ssef(hit.t));
+      if (unlikely(none(valid))) return;
+
+      /* update hit information */
+      const ssef rcpAbsDet = rcp(absDet);
+      const ssef u = U * rcpAbsDet;
+      const ssef v = V * rcpAbsDet;
+      const ssef t = T * rcpAbsDet;
+      const size_t j = select_min(valid,t);
+      hit.u   = u[j];
+      hit.v   = v[j];
+      hit.t   = t[j];
+      hit.id0 = tri.id0(i+j);
+      hit.id1 = tri.id1(i+j);
+      hit.Ng  = Vec3f(Ng.x[j],Ng.y[j],Ng.z[j]);
+    }
+
+    /*! Intersect a ray with the triangles and updates the hit. */
+    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle8c& tri, const Vec3fa* /*vertices*/)
+    {
+      STAT3(normal.trav_tris,1,1,1);
+      intersect4(ray,hit,tri,0);
+      if (tri.num > 4) intersect4(ray,hit,tri,4);
+    }
+
+    /*! Test if the ray is occluded by one of the 4 triangles starting at i. */
+    static __forceinline bool occluded4(const Ray& ray, const Triangle8c& tri, size_t i)
+    {
+      /* decompress triangles */
+      const sse3f v0 = tri.vertex(0,i);
+      const sse3f e1 = v0-tri.vertex(1,i);
+      const sse3f e2 = tri.vertex(2,i)-v0;
+      const sse3f Ng = cross(e1,e2);
+
+      /* calculate determinant */
+      const sse3f O = sse3f(ray.org);
+      const sse3f D = sse3f(ray.dir);
+      const sse3f C = v0 - O;
+      const sse3f R = cross(D,C);
+      const ssef det = dot(Ng,D);
+      const ssef absDet = abs(det);
+      const ssef sgnDet = signmsk(det);
+
+      /* perform edge tests */
+      const ssef U = dot(R,e2) ^ sgnDet;
+      const ssef V = dot(R,e1) ^ sgnDet;
+      const ssef W = absDet-U-V;
+      sseb valid = tri.valid(i) & (U >= 0.0f) & (V >= 0.0f) & (W >= 0.0f);
+      if (unlikely(none(valid))) return false;
+
+      /* perform depth test */
+      const ssef T = dot(Ng,C) ^ sgnDet;
+      valid &= (det != ssef(zero)) & (T >= absDet*ssef(ray.near)) & (absDet*ssef(ray.far) >= T);
+      if (unlikely(none(valid))) return false;
+
+      return true;
+    }
+
+    /*! Test if the ray is occluded by one of the triangles. */
+    static __forceinline bool occluded(const Ray& ray, const Triangle8c& tri, const Vec3fa* /*vertices*/ = NULL)
+    {
+      STAT3(shadow.trav_tris,1,1,1);
+      if (occluded4(ray,tri,0)) return true;
+      return tri.num > 4 && occluded4(ray,tri,4);
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,126 @@
+// ======================================================================== //
+// Copyright 2009-2012 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_ACCEL_TRIANGLE8W_H__
+#define __EMBREE_ACCEL_TRIANGLE8W_H__
+
+#include "triangle.h"
+
+namespace embree
+{
+  /*! Precalculated representation for 8 triangles. Stores for each
+      triangle the affine transformation into the space where it is
+      the unit triangle (0,0,0), (1,0,0), (0,1,0), such that a ray
+      can be intersected with dot products only. */
+  struct Triangle8w
+  {
+    /*! block size */
+    static const size_t blockSize = 8;
+    static const size_t logBlockSize = 3;
+
+    /*! Tests if we need the vertex array. */
+    static const bool needVertices = false;
+
+    /*! Cost of ray/triangle intersection. */
+    static const int intCost = 2;
+
+    /*! virtual interface to query information about the triangle type */
+    static const struct Type : public TriangleType
+    {
+      Type () : TriangleType("triangle8w",sizeof(Triangle8w),8,false,2) {}
+
+      size_t blocks(size_t x) const {
+        return (x+7)/8;
+      }
+      
+      size_t size(const char* This) const {
+        return ((Triangle8w*)This)->size();
+      }
+      
+      float area(const char* This, const Vec3fa* vertices) const {
+        return ((Triangle8w*)This)->area(vertices);
+      }
+      
+      void pack(char* This, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, const BuildTriangle* triangles, const Vec3fa* vertices) const {
+        ((Triangle8w*)This)->pack(prims,triangles,vertices);
+      }
+    } type;
+
+  public:
+
+    /*! Default constructor. */
+    __forceinline Triangle8w () {}
+
+    /*! Returns a mask that tells which triangles are valid. */
+    __forceinline avxb valid() const { return id0 != avxi(-1); }
+
+    /*! Returns the number of stored triangles. */
+    __forceinline size_t size() const {
+      return __bsf(~movemask(valid()));
+    }
+
+    /*! Computes the area of the triangle. The normal row is scaled by
+     *  the inverse length of the geometry normal. */
+    __forceinline float area(const Vec3fa* vertices) {
+      const avxf len = length(w);
+      return reduce_add(select(valid() & (len != avxf(zero)),rcp(len),avxf(0.0f)));
+    }
+
+    /*! Packs 8 triangles taken from primitive list. */
+    template<typename Iterator>
+    __forceinline void pack(Iterator& prims, const BuildTriangle* triangles, const Vec3fa* vertices)
+    {
+      id0 = -1; id1 = -1;
+      u = v = w = zero; du = dv = dw = zero;
+      
+      for (size_t i=0; i<8 && prims; i++, prims++)
+      {
+        const PrimRef& prim = *prims;
+        const BuildTriangle& tri = triangles[prim.id()];
+        const Vec3f p0 = vertices[tri.v0];
+        const Vec3f p1 = vertices[tri.v1];
+        const Vec3f p2 = vertices[tri.v2];
+        id0[i] = tri.id0 & 0x7FFFFFFF; // no support for motion blur
+        id1[i] = tri.id1;
+
+        /*! invert the matrix with columns e1, e2, and N = cross(e1,e2),
+         *  whose determinant is dot(N,N); degenerate triangles keep a
+         *  zero transformation, which no ray hits */
+        const Vec3f e1 = p1-p0, e2 = p2-p0, N = cross(e1,e2);
+        const float det = dot(N,N);
+        if (det == 0.0f) continue;
+        const float rcpDet = 1.0f/det;
+        const Vec3f ru = cross(e2,N)*rcpDet, rv = cross(N,e1)*rcpDet, rw = N*rcpDet;
+        u.x[i] = ru.x; u.y[i] = ru.y; u.z[i] = ru.z; du[i] = -dot(ru,p0);
+        v.x[i] = rv.x; v.y[i] = rv.y; v.z[i] = rv.z; dv[i] = -dot(rv,p0);
+        w.x[i] = rw.x; w.y[i] = rw.y; w.z[i] = rw.z; dw[i] = -dot(rw,p0);
+      }
+    }
+
+  public:
+    avx3f u;      //!< Row of the transformation giving the 1st barycentric coordinate.
+    avx3f v;      //!< Row of the transformation giving the 2nd barycentric coordinate.
+    avx3f w;      //!< Row of the transformation giving the distance along the normal.
+    avxf du;      //!< Translation of the 1st row.
+    avxf dv;      //!< Translation of the 2nd row.
+    avxf dw;      //!< Translation of the 3rd row.
+    avxi id0;      //!< 1st user ID.
+    avxi id1;      //!< 2nd user ID.
+  };
+}
+
+#endif
+
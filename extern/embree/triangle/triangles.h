@@ -25,6 +25,9 @@
 #include "triangle1.h"
 #include "triangle4.h"
 #include "triangle8.h"
+#include "triangle4w.h"
+#include "triangle8w.h"
+#include "triangle8c.h"
 
 /*! include single ray triangle intersectors */
 #include "triangle1i_intersector1_moeller.h"
@@ -40,6 +43,9 @@
 #include "triangle1_intersector1_moeller.h"
 #include "triangle4_intersector1_moeller.h"
 #include "triangle8_intersector1_moeller.h"
+#include "triangle4w_intersector1_woop.h"
+#include "triangle8w_intersector1_woop.h"
+#include "triangle8c_intersector1_moeller.h"
 
 #define INSTANTIATE_TEMPLATE_BY_INTERSECTOR(Base)                       \
   template class Base<Triangle1iIntersectorMoellerTrumbore>;            \
@@ -53,6 +59,9 @@
   template class Base<Triangle1IntersectorMoellerTrumbore>;             \
   template class Base<Triangle4IntersectorMoellerTrumbore>;             \
   template class Base<Triangle8IntersectorMoellerTrumbore>;             \
+  template class Base<Triangle4wIntersectorWoop>;                       \
+  template class Base<Triangle8wIntersectorWoop>;                       \
+  template class Base<Triangle8cIntersectorMoellerTrumbore>;            \
 
 #define INSTANTIATE_TEMPLATE_BY_INTERSECTOR_MB(Base)            \
   template class Base<Triangle4iIntersectorMoellerTrumboreMB>;  \
@@ -40,6 +40,8 @@ public:
 
     Color sample(const Vector3f &p, float pEps, Vector3f &wi, Light::VisibilityTester &vis) const;
 
+    void sample(const Vector3f &p, float pEps, Light::SamplePacket &packet) const;
+
     Color power(const Scene &scene) const;
 
     bool isDeltaLight() const {
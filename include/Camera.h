@@ -50,10 +50,11 @@ public:
         rasterToCamera = cameraToScreen.inverse() * rasterToScreen;
     }
 
-    Ray generateRay(size_t imageX, size_t imageY) const {
+    // time is the fraction of the shutter interval at which the ray samples the scene
+    Ray generateRay(size_t imageX, size_t imageY, float time = 0.f) const {
         using namespace embree;
         const auto pCam = (rasterToCamera * Vector3f(imageX, imageY, 0.f)).normalized();
-        Ray ray(Vec3f(0.f), Vec3f(pCam.x(), pCam.y(), pCam.z()));
+        Ray ray(Vec3f(0.f), Vec3f(pCam.x(), pCam.y(), pCam.z()), zero, inf, time);
         return cameraToWorld * ray;
     }
 
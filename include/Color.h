@@ -51,6 +51,10 @@ public:
 //    }
 };
 
+inline float Luminance(const Color &c) {
+    return .2126f * c.x() + .7152f * c.y() + .0722f * c.z();
+}
+
 }
 
 #endif /* COLOR_H_ */
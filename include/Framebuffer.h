@@ -0,0 +1,72 @@
+/*
+ *  Copyright (C) 2012 Xo Wang
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL XO
+ *  WANG BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ *  AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *  Except as contained in this notice, the name of Xo Wang shall not be
+ *  used in advertising or otherwise to promote the sale, use or other dealings
+ *  in this Software without prior written authorization from Xo Wang.
+ */
+
+#ifndef FRAMEBUFFER_H_
+#define FRAMEBUFFER_H_
+
+#include "Trayrace.h"
+
+#include "PixelToaster/PixelToaster.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace Trayrace {
+
+// Radiance written by the renderer, plus its display-ready copy. Tiles are tone-mapped, gamma-encoded and packed to
+// 8 bits as they finish, so presenting a frame only uploads the pixels that changed since the last present.
+class Framebuffer {
+public:
+    typedef PixelToaster::TrueColorPixel TrueColorPixel;
+
+    const size_t width;
+    const size_t height;
+    // scale applied to radiance before tone-mapping
+    float exposure;
+
+    std::vector<Pixel> hdr;
+    std::vector<TrueColorPixel> ldr;
+
+    Framebuffer(size_t width, size_t height, float exposure = 1.f);
+
+    // converts [x0, x1) x [y0, y1) of hdr into ldr; may be called concurrently for disjoint rectangles
+    void resolve(size_t x0, size_t x1, size_t y0, size_t y1);
+
+    // sends everything resolved since the last present to the display, which must be in Mode::TrueColor
+    bool present(PixelToaster::Display &display);
+
+    // returns the time spent in present since the last call
+    double takePresentSeconds();
+
+protected:
+    std::mutex dirtyMutex;
+    PixelToaster::Rectangle dirty;
+    std::atomic<long long> presentNanoseconds;
+};
+
+}
+
+#endif /* FRAMEBUFFER_H_ */
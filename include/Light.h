@@ -49,6 +49,11 @@ public:
             ray = Ray(EmbV(p1), EmbV((p2 - p1) / dist), eps1, dist * (1.f - eps2));
         }
 
+        // segment from p along normalized direction w, when the direction and distance are already known
+        void setSegment(const Vector3f &p, float eps1, const embree::Vec3f &w, float dist, float eps2) {
+            ray = Ray(EmbV(p), w, eps1, dist * (1.f - eps2));
+        }
+
         void setRay(const Vector3f &p, float eps, const Vector3f &w) {
             ray = Ray(EmbV(p), EmbV(w), eps);
         }
@@ -56,6 +61,17 @@ public:
         bool unoccluded(const Scene &scene) const {
             return !scene.occluded(ray);
         }
+
+        bool unoccluded(const Scene &scene, embree::OcclusionCache &cache) const {
+            return !scene.occluded(ray, cache);
+        }
+    };
+
+    // SoA batch of SIMD_WIDTH light samples taken from one shading point
+    struct SamplePacket {
+        SimdVector3f wi;
+        SimdVector3f li;
+        VisibilityTester vis[SIMD_WIDTH];
     };
 
     Light(const Transform &lightToWorld, size_t nSamples = 1) :
@@ -69,6 +85,20 @@ public:
 
     virtual Color sample(const Vector3f &p, float pEps, Vector3f &wi, VisibilityTester &vis) const = 0;
 
+    // fills every lane of the packet; lights without a SIMD sampler fall back to scalar samples
+    virtual void sample(const Vector3f &p, float pEps, SamplePacket &packet) const {
+        Vector3f wi;
+        for (size_t k = 0; k < SIMD_WIDTH; k++) {
+            const Color li = sample(p, pEps, wi, packet.vis[k]);
+            packet.wi.x[k] = wi.x();
+            packet.wi.y[k] = wi.y();
+            packet.wi.z[k] = wi.z();
+            packet.li.x[k] = li.x();
+            packet.li.y[k] = li.y();
+            packet.li.z[k] = li.z();
+        }
+    }
+
     virtual Color power(const Scene &scene) const = 0;
 
     virtual bool isDeltaLight() const = 0;
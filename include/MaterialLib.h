@@ -29,14 +29,27 @@
 #include "Trayrace.h"
 
 #include <map>
+#include <mutex>
+#include <future>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
 
 namespace Trayrace {
 
+// Registry of materials shared by all objects in a scene. Objects may be loaded concurrently: material names are
+// interned to IDs under a lock as they're used, while each .mtl file is parsed once on its own thread. finalize()
+// flattens the parsed materials into a table that is read without locking while rendering.
 class MaterialLib {
 public:
-    friend class Renderer;
-    struct Material {
+    typedef uint16_t MaterialId;
+
+    // index of the material used for faces without a (valid) usemtl
+    static constexpr MaterialId DEFAULT_MATERIAL = 0;
+
+    struct TR_ALIGN(64) Material {
         Vector3f ambientColor;
         Vector3f diffuseColor;
         Vector3f specularColor;
@@ -50,13 +63,34 @@ public:
         }
     };
 
-    static const Material *load(const std::string &path, const std::string &mtlName);
+    MaterialLib();
+
+    // starts parsing a material file in the background if it hasn't been requested yet
+    void request(const std::string &path);
+
+    // returns the ID that the named material will have in the material table
+    MaterialId intern(const std::string &path, const std::string &mtlName);
+
+    // waits for outstanding parses and publishes all interned materials into the material table
+    void finalize();
+
+    const Material &get(MaterialId id) const {
+        return materials[id];
+    }
 
 protected:
-    typedef std::map<std::string, std::map<std::string, Material>> FileToNameToMaterial_t;
-    static FileToNameToMaterial_t fileToNameToMtl;
+    typedef std::map<std::string, Material> NameToMaterial_t;
+    typedef std::vector<Material, AlignedAllocator<Material>> MaterialTable_t;
+
+    std::mutex internMutex;
+    std::map<std::string, std::shared_future<NameToMaterial_t>> pathToFile;
+    std::map<std::pair<std::string, std::string>, MaterialId> keyToMtlId;
+    std::vector<std::pair<std::string, std::string>> mtlIdToKey;
+    MaterialTable_t materials;
+
+    void requestLocked(const std::string &path);
 
-    static bool parseFile(const std::string &path);
+    static NameToMaterial_t parseFile(const std::string &path);
 };
 
 }
@@ -47,8 +47,8 @@ public:
         IndexT vertexIdxs[4];
         IndexT texcoordIdxs[4];
         IndexT normalIdxs[4];
+        MaterialLib::MaterialId matId;
         bool isQuad;
-        const MaterialLib::Material *mat;
     };
 
     const std::string path;
@@ -57,9 +57,22 @@ public:
     std::vector<Vector3f> normals;
     std::vector<Face> faces;
 
-    Object(const std::string &path);
+    Object(const std::string &path, MaterialLib &materialLib);
     virtual ~Object();
 
+    // number of embree vertices toEmbree writes: moving objects take a position and a motion vector per vertex
+    size_t numBuildVertices() const {
+        return moving ? 2 * vertices.size() : vertices.size();
+    }
+
+    // bytes of the geometry arrays, which copies of the object duplicate
+    size_t bytes() const {
+        return vertices.size() * sizeof(Vector3f) + texcoords.size() * sizeof(Vector2f)
+                + normals.size() * sizeof(Vector3f) + faces.size() * sizeof(Face);
+    }
+
+    // moving objects are written in the bvh4mb format: triangles index the shutter open position of each vertex,
+    // which is followed by its motion over the shutter interval, and have the top bit of id0 set
     void toEmbree(const int id0,
             embree::BuildVertex * const vertices,
             const size_t vertexOffset,
@@ -68,8 +81,26 @@ public:
 
     void transformBy(const Transform &transform);
 
+    // places the object at shutter open and close; it moves linearly in between during a frame
+    void setMotion(const Transform &start, const Transform &end);
+
+    bool isMoving() const {
+        return moving;
+    }
+
+    // world space vertex position and shading normal at a shutter time in [0, 1]
+    Vector3f vertexAt(IndexT i, float time) const;
+
+    Vector3f normalAt(IndexT i, float time) const;
+
 protected:
-    bool loadFile(const std::string &path);
+    Transform startTransform;
+    Transform endTransform;
+    Transform startNormalTransform;
+    Transform endNormalTransform;
+    bool moving;
+
+    bool loadFile(const std::string &path, MaterialLib &materialLib);
 };
 
 }
@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) 2012 Xo Wang
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL XO
+ *  WANG BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ *  AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *  Except as contained in this notice, the name of Xo Wang shall not be
+ *  used in advertising or otherwise to promote the sale, use or other dealings
+ *  in this Software without prior written authorization from Xo Wang.
+ */
+
+#ifndef RAYQUEUE_H_
+#define RAYQUEUE_H_
+
+#include "Trayrace.h"
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace Trayrace {
+
+// Buffers rays so they can be traced in an order that keeps consecutive rays coherent: grouped by direction octant,
+// then along a Morton curve through the cells of their origins. Neighbouring rays then visit mostly the same BVH
+// nodes, which are still in cache.
+class RayQueue {
+public:
+    // bits of Morton code per axis of the origin grid
+    static constexpr uint32_t CELL_BITS = 9;
+
+    RayQueue();
+
+    // sets the region over which ray origins are quantized into cells
+    void setBounds(const BoundBox &bounds);
+
+    void clear() {
+        rays.clear();
+        tags.clear();
+        order.clear();
+    }
+
+    size_t size() const {
+        return rays.size();
+    }
+
+    // queues a ray with a caller-defined tag identifying its payload
+    void push(const Ray &ray, uint32_t tag);
+
+    // orders the queued rays for tracing
+    void sort();
+
+    // i-th ray in traversal order, valid after sort
+    const Ray &ray(size_t i) const {
+        return rays[uint32_t(order[i])];
+    }
+
+    uint32_t tag(size_t i) const {
+        return tags[uint32_t(order[i])];
+    }
+
+protected:
+    embree::Vec3f lower;
+    embree::Vec3f cellScale;
+    std::vector<Ray> rays;
+    std::vector<uint32_t> tags;
+    // sort key in the high 32 bits, index into rays in the low 32 bits
+    std::vector<uint64_t> order;
+};
+
+}
+
+#endif /* RAYQUEUE_H_ */
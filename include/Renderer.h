@@ -28,48 +28,221 @@
 
 #include "Trayrace.h"
 #include "Color.h"
+#include "Framebuffer.h"
+
+#include "Light.h"
+#include "MaterialLib.h"
+#include "RayQueue.h"
 
 #include <mutex>
 #include <atomic>
+#include <limits>
+#include <memory>
+#include <random>
 #include <thread>
 #include <vector>
+#include <fstream>
 #include <condition_variable>
 
+#include <stdint.h>
+
 namespace Trayrace {
 
 class Camera;
+class Object;
 class Scene;
 
 class Renderer {
 public:
-    Renderer(size_t width, size_t height, size_t nThreads);
+    // a positive errorThreshold enables adaptive sampling: pixels stop taking light samples once the standard error
+    // of their mean drops below errorThreshold relative to their brightness, and the saved samples go to noisy tiles;
+    // if the TRAYRACE_METRICS environment variable names a file, a JSON line of frame metrics is appended to it after
+    // every frame;
+    // a nonzero maxBounces switches to wavefront path tracing: every pass then traces one diffuse path per pixel
+    // through up to maxBounces bounces, stage by stage over the whole tile, and lights each of its vertices
+    Renderer(size_t width, size_t height, size_t nThreads, float errorThreshold = 0.f, size_t maxBounces = 0);
 
     ~Renderer();
 
-    void start(const Scene &scene, const Camera &camera, std::vector<Pixel> &pixels);
+    void start(const Scene &scene, const Camera &camera, Framebuffer &framebuffer);
 
     bool started() const {
         return workersAwake;
     }
 
     bool done() const {
-        return workersComplete == nThreads;
+        return frameDone;
     }
 
 protected:
+    static constexpr size_t TILE_SIZE = 16;
+    // passes a pixel takes before its variance estimate is trusted
+    static constexpr size_t MIN_ADAPTIVE_PASSES = 4;
+    // cap on passes spent refining a pixel, as a multiple of the nominal pass count
+    static constexpr size_t MAX_REFINE_RATIO = 4;
+    // floor on the brightness used for the relative error test, so black pixels can converge
+    static constexpr float MIN_LUMINANCE = 1e-2f;
+    // bounce from which paths are terminated at random in proportion to their throughput (Russian roulette)
+    static constexpr size_t MIN_ROULETTE_BOUNCE = 2;
+
+    // running luminance statistics of a pixel's passes (Welford's method)
+    struct SampleStats {
+        uint32_t n;
+        float mean;
+        float m2;
+
+        void clear() {
+            n = 0;
+            mean = m2 = 0.f;
+        }
+
+        void add(float x) {
+            n++;
+            const float delta = x - mean;
+            mean += delta / n;
+            m2 += delta * (x - mean);
+        }
+
+        // squared standard error of the mean
+        float meanVariance() const {
+            return n > 1 ? m2 / ((n - 1) * float(n)) : std::numeric_limits<float>::infinity();
+        }
+    };
+
+    struct TileStats {
+        // summed squared error of the tile's unconverged pixels
+        float priority;
+        size_t unconverged;
+        // passes left unused by pixels that converged early
+        size_t sparePasses;
+    };
+
+    // a null material marks a pixel whose camera ray missed at this pass's time
+    struct SurfacePoint {
+        Vector3f p;
+        Vector3f ng;
+        Vector3f ns;
+        const MaterialLib::Material *mat;
+        // shutter time its rays are traced at
+        float time;
+    };
+
+    // shadow ray payload: the tile pixel slot it lights, its light, and what it adds to the pixel if unoccluded
+    struct ShadowSample {
+        uint32_t slot;
+        uint32_t light;
+        Vector3f contribution;
+    };
+
+    // SoA queue of path states: the tile pixel slot a path lights and the throughput it carries
+    struct PathQueue {
+        std::vector<uint32_t> slots;
+        std::vector<float> throughputX;
+        std::vector<float> throughputY;
+        std::vector<float> throughputZ;
+
+        void clear() {
+            slots.clear();
+            throughputX.clear();
+            throughputY.clear();
+            throughputZ.clear();
+        }
+
+        size_t size() const {
+            return slots.size();
+        }
+
+        void push(uint32_t slot, const Vector3f &throughput) {
+            slots.push_back(slot);
+            throughputX.push_back(throughput.x());
+            throughputY.push_back(throughput.y());
+            throughputZ.push_back(throughput.z());
+        }
+
+        Vector3f throughput(size_t i) const {
+            return Vector3f(throughputX[i], throughputY[i], throughputZ[i]);
+        }
+    };
+
+    // scratch space and counters of one worker for the current frame
+    struct WorkerContext {
+        // the scene's objects on the worker's NUMA node
+        const std::vector<std::shared_ptr<Object>> *objects;
+        Light::SamplePacket packet;
+        // last blocker of each light's shadow rays
+        std::vector<embree::OcclusionCache> occlusionCaches;
+        // per pixel slot of the current tile: its visible surface, running mean and color for the current pass
+        std::vector<SurfacePoint> surfacePoints;
+        std::vector<Color, AlignedAllocator<Color>> means;
+        std::vector<Color, AlignedAllocator<Color>> passColors;
+        // slots with a visible surface (all of them when the scene moves), and those still taking passes
+        std::vector<uint32_t> hitSlots;
+        std::vector<uint32_t> activeSlots;
+        // shadow rays of the current pass, traced in coherent order
+        RayQueue shadowQueue;
+        std::vector<ShadowSample> shadowSamples;
+        // path tracing: paths waiting to be shaded and the surfaces they reached, and the paths whose bounce rays
+        // are waiting to be traced
+        PathQueue paths;
+        std::vector<SurfacePoint> pathPoints;
+        PathQueue bouncePaths;
+        RayQueue bounceQueue;
+        std::mt19937 rng;
+        size_t shadowRays;
+        // cycles spent inside the acceleration structure, converting tiles for display, and working on tiles at all
+        uint64_t traversalTicks;
+        uint64_t resolveTicks;
+        uint64_t busyTicks;
+    };
+
+    struct WorkerTimes {
+        uint64_t traversalTicks;
+        uint64_t resolveTicks;
+        uint64_t busyTicks;
+    };
+
     const size_t width;
     const size_t height;
     const size_t nThreads;
+    const float errorThreshold;
+    const size_t maxBounces;
+    const size_t tilesX;
+    const size_t tilesY;
 
-    std::atomic_size_t currentRow;
+    std::atomic_size_t currentTile;
     time_point renderStartTime;
 
+    // nominal number of light sample passes per pixel, each taking a packet of SIMD_WIDTH samples per light
+    size_t maxPasses;
+    std::vector<SampleStats> sampleStats;
+    std::vector<TileStats> tileStats;
+    std::atomic_size_t shadowRays;
+    size_t frameIndex;
+    uint64_t renderStartTicks;
+    std::vector<WorkerTimes> workerTimes;
+    std::ofstream metricsStream;
+
+    // traversal work done on each tile, taken from the embree per-thread counters, and its sum over the last frame
+    typedef embree::Stat::Counters TraversalCounters;
+    std::vector<TraversalCounters, AlignedAllocator<TraversalCounters>> tileCounters;
+    TraversalCounters frameCounters;
+
+    // tiles queued for refinement, noisiest first, and the passes left to spend on them
+    std::vector<size_t> refineTiles;
+    std::atomic_size_t currentRefineTile;
+    std::atomic<long long> refineBudget;
+    std::atomic_size_t workersSampled;
+    bool refineReady;
+    std::mutex refineMutex;
+    std::condition_variable refineCondVar;
+
     // todo: this should be std::atomic_bool but libc++ doesn't have it
     std::atomic<bool> workersRunning;
     std::vector<std::thread> workers;
 
-    // number of workers done rendering
+    // number of workers done rendering, and whether the last of them has also reported the frame
     std::atomic_size_t workersComplete;
+    std::atomic<bool> frameDone;
 
     // controls worker run/stop
     std::atomic<bool> workersAwake;
@@ -78,11 +251,64 @@ protected:
 
     const Scene * volatile scene;
     const Camera * volatile camera;
-    std::vector<Pixel> * volatile pixels;
+    Framebuffer * volatile framebuffer;
+
+    inline SimdFloat shade(const Vector3f &n, const SimdVector3f &wi);
+
+    bool converged(const SampleStats &stats) const;
+
+    // shading point of a ray's hit, from the normal and distance the intersector returns
+    void surfaceAt(const Ray &ray, const Hit &hit, const WorkerContext &ctx, SurfacePoint &sp) const;
+
+    // the tracing stages and everything calling them are instantiated per traverser (see Scene::traverse)
+    template<typename Traversal>
+    bool traceCameraRay(const Traversal &traversal, size_t i, size_t j, float time, SurfacePoint &sp,
+            WorkerContext &ctx) const;
+
+    template<typename Traversal>
+    void traceCameraRays(const Traversal &traversal, size_t x0, size_t y0, WorkerContext &ctx);
+
+    void queueShadowRays(uint32_t slot, const SurfacePoint &sp, const Vector3f &throughput, WorkerContext &ctx);
+
+    template<typename Traversal>
+    void traceShadowRays(const Traversal &traversal, WorkerContext &ctx);
+
+    template<typename Traversal>
+    void tracePaths(const Traversal &traversal, WorkerContext &ctx);
+
+    template<typename Traversal>
+    void samplePass(const Traversal &traversal, WorkerContext &ctx);
+
+    template<typename Traversal>
+    void sampleTile(const Traversal &traversal, size_t tile, WorkerContext &ctx);
+
+    template<typename Traversal>
+    void refineTile(const Traversal &traversal, size_t tile, WorkerContext &ctx);
+
+    // samples the tiles a worker takes for the frame, then refines its share of the noisiest ones
+    template<typename Traversal>
+    void renderTiles(const Traversal &traversal, WorkerContext &ctx);
+
+    // visitor that hands a worker's frame to renderTiles with the scene's traversal
+    struct TilesVisitor {
+        Renderer &renderer;
+        WorkerContext &ctx;
+
+        template<typename Traversal>
+        void operator()(const Traversal &traversal) {
+            renderer.renderTiles(traversal, ctx);
+        }
+    };
+
+    void resolveTile(size_t x0, size_t x1, size_t y0, size_t y1, WorkerContext &ctx);
+
+    void queueRefinement();
+
+    void finishFrame();
 
-    inline Color shade(const Vector3f &n, const Vector3f &wi);
+    void writeMetrics(double frameSeconds, double tickSeconds);
 
-    void renderThread();
+    void renderThread(size_t workerIdx);
 };
 
 }
@@ -27,9 +27,15 @@
 #define SCENE_H_
 
 #include "Trayrace.h"
+#include "MaterialLib.h"
 
+#include "embree/common/accel.h"
 #include "embree/common/intersector.h"
+#include "embree/bvh4/bvh4_intersector.h"
+#include "embree/bvh4mb/bvh4mb_intersector.h"
+#include "embree/triangle/triangles.h"
 
+#include <string>
 #include <vector>
 #include <memory>
 
@@ -42,9 +48,80 @@ class Scene {
 public:
     friend class Renderer;
 
+    // how build trades construction time, trace speed and memory
+    enum class BuildPolicy {
+        // object-split BVH over triangles precomputed for intersection
+        FastBuild,
+        // spatial-split BVH over precomputed triangles
+        FastTrace,
+        // object-split BVH over compressed triangles, which share a table of vertices quantized to 16 bits per block
+        LowMemory,
+        // one of the above, from the triangle count and whether precomputed triangles fit in the memory budget;
+        // FastTrace builds then get as much of the spatial split budget as the memory budget leaves room for
+        Auto
+    };
+
+    // below this many triangles, Auto skips spatial splits: their faster traversal rarely makes up for the
+    // longer build of an interactive scene
+    static constexpr size_t FAST_BUILD_MAX_TRIANGLES = 1 << 16;
+    // fraction of physical memory the default memory budget allows
+    static constexpr size_t MEMORY_BUDGET_DIVISOR = 4;
+    // default spatial split budget: at most 1.3x the scene's triangle references
+    static constexpr float SPATIAL_SPLIT_BUDGET = .3f;
+    // default early split threshold, as a fraction of the scene bounds' surface area
+    static constexpr float EARLY_SPLIT_THRESHOLD = .002f;
+    // default traversal prefetch distance: the next node to pop past the one about to be visited
+    static constexpr size_t TRAVERSAL_PREFETCH_DISTANCE = 1;
+    // structures smaller than this mostly stay in the last level cache, where prefetching only costs instructions
+    static constexpr size_t PREFETCH_MIN_BYTES = size_t(32) << 20;
+    // default treelet restructuring rounds
+    static constexpr size_t TREELET_RESTRUCTURING = 0;
+
+    // materials of the objects loaded into this scene
+    MaterialLib materialLib;
+
+    // bytes the acceleration structure may take under the Auto policy
+    size_t memoryBudget;
+
+    // extra triangle references a spatial-split build may add, as a fraction of the triangle count; once used up,
+    // the build continues with object splits. The Auto policy lowers it where the references would exceed the
+    // memory budget
+    float spatialSplitBudget;
+
+    // triangles with bounds larger than this fraction of the scene's surface area, and mostly empty, are split
+    // into tighter boxes before FastTrace builds, drawing the extra references from the spatial split budget; zero
+    // disables early splitting
+    float earlySplitThreshold;
+
+    // how many stack entries ahead BVH4 traversal prefetches nodes, besides the children it is about to visit and
+    // the vertices of indexed leaves; only used for structures of at least PREFETCH_MIN_BYTES, and zero disables
+    // prefetching
+    size_t traversalPrefetchDistance;
+
+    // treelet restructuring rounds BVH4 builds run over the finished tree in place of rotations; each round searches
+    // every node's treelet of up to 7 subtrees for the topology of lowest SAH cost, which mostly saves nodes after the
+    // SAH builds here and costs about as much time as building the hierarchy; zero keeps the rotations
+    size_t treeletRestructuring;
+
+    // whether FastTrace builds copy the BVH into one block in depth-first order; this briefly needs memory for both
+    // copies, so the other policies, which favor build time or memory, skip it
+    bool depthFirstLayout;
+
+    // whether geometry arrays, nodes and triangles are allocated on huge pages where the system provides them, to
+    // cut TLB misses in traversal
+    bool hugePages;
+
+    // whether machines with several NUMA nodes get a copy of the BVH and objects in each node's memory after the
+    // build, so render threads bound to a node traverse and shade local data; skipped when the copies would exceed
+    // the memory budget, for structures that can't be copied, or where threads can't be bound to the nodes
+    bool numaReplication;
+
     Scene();
 
-    void build(const std::vector<std::shared_ptr<Object>> &objects, const std::vector<std::shared_ptr<Light>> &lights);
+    // scenes with moving objects always use the motion blur BVH, whatever the policy
+    void build(const std::vector<std::shared_ptr<Object>> &objects,
+            const std::vector<std::shared_ptr<Light>> &lights,
+            BuildPolicy policy = BuildPolicy::Auto);
 
     void intersect(const Ray& ray, Hit& hit) const {
         intersector->intersect(ray, hit);
@@ -54,12 +131,143 @@ public:
         return intersector->occluded(ray);
     }
 
+    // tests the cache's last occluder before traversing, and remembers the occluder found
+    bool occluded(const Ray& ray, embree::OcclusionCache &cache) const {
+        return intersector->occluded(ray, cache);
+    }
+
+    // rays traced through one concrete traverser, whose calls aren't virtual and can be inlined into the caller
+    template<typename Traverser>
+    class Traversal {
+    public:
+        explicit Traversal(const Traverser &traverser) :
+                traverser(traverser) {
+        }
+
+        void intersect(const Ray& ray, Hit& hit) const {
+            traverser.Traverser::intersect(ray, hit);
+        }
+
+        bool occluded(const Ray& ray, embree::OcclusionCache &cache) const {
+            return traverser.Traverser::occluded(ray, cache);
+        }
+
+    protected:
+        const Traverser &traverser;
+    };
+
+    // calls visitor(traversal) with the Traversal of the traverser the last build created, over the copy on the
+    // given NUMA node if there is one; the visitor's call operator is instantiated per traverser, so rays traced
+    // inside it skip the virtual Intersector interface
+    template<typename Visitor>
+    void traverse(Visitor &visitor, size_t node = 0) const;
+
+    // the objects hits on the given NUMA node are shaded with, which hit.id0 indexes
+    const std::vector<std::shared_ptr<Object>> &objectsOn(size_t node) const {
+        return replicas.empty() ? objects : replicas[node % replicas.size()].objects;
+    }
+
 protected:
+#ifdef __AVX__
+    typedef embree::Triangle8IntersectorMoellerTrumbore PrecomputedIntersector;
+#else
+    typedef embree::Triangle4IntersectorMoellerTrumbore PrecomputedIntersector;
+#endif
+
+    // traversers a build can create, and the interface any other one is used through
+    enum class TraverserType {
+        Virtual,
+        Precomputed,
+        Compressed,
+        Motion
+    };
+
+    // traverser and objects copied into one NUMA node's memory
+    struct Replica {
+        embree::Ref<embree::Intersector> intersector;
+        TraverserType traverserType;
+        std::vector<std::shared_ptr<Object>> objects;
+    };
+
+    static TraverserType classify(const embree::Intersector *intersector);
+
+    template<typename Visitor>
+    static void traverse(Visitor &visitor, const embree::Intersector &intersector, TraverserType traverserType);
+
+    // copies the structure and objects onto each of the NUMA nodes, from a thread bound to the node
+    void replicate(const embree::Ref<embree::Accel> &accel, size_t numaNodes);
+
     embree::Ref<embree::Intersector> intersector;
+    TraverserType traverserType;
+    embree::Accel::BuildTimes buildTimes;
+    // bytes of the process backed by huge pages after the last build
+    size_t hugePageBytes;
+    // structure and triangle layout the last build chose
+    std::string accelType;
+    std::string triangleType;
+    size_t numTriangles;
+    BoundBox bounds;
+    // whether any object moves while the shutter is open
+    bool motion;
     std::vector<std::shared_ptr<Object>> objects;
     std::vector<std::shared_ptr<Light>> lights;
+    // one per NUMA node, or none where the machine has one node or replication was skipped
+    std::vector<Replica> replicas;
+};
+
+// traversers of unknown type are still called through the virtual interface
+template<>
+class Scene::Traversal<embree::Intersector> {
+public:
+    explicit Traversal(const embree::Intersector &traverser) :
+            traverser(traverser) {
+    }
+
+    void intersect(const Ray& ray, Hit& hit) const {
+        traverser.intersect(ray, hit);
+    }
+
+    bool occluded(const Ray& ray, embree::OcclusionCache &cache) const {
+        return traverser.occluded(ray, cache);
+    }
+
+protected:
+    const embree::Intersector &traverser;
 };
 
+template<typename Visitor>
+void Scene::traverse(Visitor &visitor, size_t node) const {
+    if (replicas.empty()) {
+        traverse(visitor, *intersector, traverserType);
+    } else {
+        const Replica &replica = replicas[node % replicas.size()];
+        traverse(visitor, *replica.intersector, replica.traverserType);
+    }
+}
+
+template<typename Visitor>
+void Scene::traverse(Visitor &visitor, const embree::Intersector &intersector, TraverserType traverserType) {
+    using namespace embree;
+    typedef BVH4Intersector<PrecomputedIntersector> PrecomputedTraverser;
+    typedef BVH4Intersector<Triangle8cIntersectorMoellerTrumbore> CompressedTraverser;
+    typedef BVH4MBIntersector<Triangle4iIntersectorPlueckerMB> MotionTraverser;
+
+    switch (traverserType) {
+    case TraverserType::Precomputed:
+        visitor(Traversal<PrecomputedTraverser>(static_cast<const PrecomputedTraverser &>(intersector)));
+        break;
+    case TraverserType::Compressed:
+        visitor(Traversal<CompressedTraverser>(static_cast<const CompressedTraverser &>(intersector)));
+        break;
+    case TraverserType::Motion:
+        visitor(Traversal<MotionTraverser>(static_cast<const MotionTraverser &>(intersector)));
+        break;
+    default:
+        visitor(Traversal<Intersector>(intersector));
+        break;
+    }
+}
+
 }
 
 #endif /* SCENE_H_ */
@@ -36,6 +36,7 @@
 
 #include <array>
 #include <chrono>
+#include <memory>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -64,11 +65,40 @@ inline Scalar Clamp(Scalar s, T1 min, T2 max) {
     return std::min(std::max(s, Scalar(min)), Scalar(max));
 }
 
+template<typename T>
+inline T Square(T t) {
+    return t * t;
+}
+
 template<typename T, typename Scalar>
 inline auto BaryLerp(const T &v0, const T &v1, const T &v2, Scalar u, Scalar v) -> decltype(v1 * u + v2 * v + v0 * (Scalar(1.0) - u - v)) {
     return v1 * u + v2 * v + v0 * (Scalar(1.0) - u - v);
 }
 
+// STL allocator for arrays whose elements must not straddle cache lines
+template<typename T, size_t Alignment = 64>
+struct AlignedAllocator: public std::allocator<T> {
+    template<typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() {
+    }
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) {
+    }
+
+    T *allocate(size_t n, const void * = nullptr) {
+        return static_cast<T *>(embree::alignedMalloc(n * sizeof(T), Alignment));
+    }
+
+    void deallocate(T *p, size_t) {
+        embree::alignedFree(p);
+    }
+};
+
 constexpr float EPS = 1e-4f;
 
 typedef Eigen::Vector2f Vector2f;
@@ -80,12 +110,28 @@ typedef Eigen::AlignedBox3f BoundBox;
 typedef embree::Ray Ray;
 typedef embree::Hit Hit;
 
+// SIMD vectors as wide as the machine, for shading packets of samples
+#ifdef __AVX__
+typedef embree::avxf SimdFloat;
+typedef embree::avxb SimdBool;
+#else
+typedef embree::ssef SimdFloat;
+typedef embree::sseb SimdBool;
+#endif
+typedef embree::Vec3<SimdFloat> SimdVector3f;
+
+constexpr size_t SIMD_WIDTH = sizeof(SimdFloat) / sizeof(float);
+
 inline embree::Vec3f EmbV(const Vector3f &v) {
     embree::Vec3f embV;
     Eigen::Map<Vector3f>(&embV.x) = v;
     return embV;
 }
 
+inline Vector3f EigV(const embree::Vec3f &v) {
+    return Eigen::Map<const Vector3f>(&v.x);
+}
+
 typedef PixelToaster::Pixel Pixel;
 typedef PixelToaster::Timer Timer;
 
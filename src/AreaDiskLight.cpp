@@ -70,6 +70,20 @@ static inline void UniformSampleDisk(float u1, float u2, float &x, float &y) {
     y = r * ::sinf(theta);
 }
 
+// Same distribution as the scalar version, but the angle is taken as twice a half angle in [-pi/2, pi/2), where
+// Taylor series for sine and cosine place the point within 5e-7 of the unit circle's, close to float precision.
+static inline void UniformSampleDisk(const SimdFloat &u1, const SimdFloat &u2, SimdFloat &x, SimdFloat &y) {
+    const SimdFloat r = sqrt(u1);
+    const SimdFloat h = float(M_PI) * (u2 - .5f);
+    const SimdFloat h2 = h * h;
+    const SimdFloat sinH = h * (1.f + h2 * (-1.f / 6.f + h2 * (1.f / 120.f + h2 * (-1.f / 5040.f + h2 * (1.f / 362880.f
+            + h2 * (-1.f / 39916800.f))))));
+    const SimdFloat cosH = 1.f + h2 * (-.5f + h2 * (1.f / 24.f + h2 * (-1.f / 720.f + h2 * (1.f / 40320.f
+            + h2 * (-1.f / 3628800.f + h2 * (1.f / 479001600.f))))));
+    x = r * (cosH * cosH - sinH * sinH);
+    y = r * (2.f * sinH * cosH);
+}
+
 Vector3f AreaDiskLight::sample(float u1, float u2, Vector3f &ns) const {
     Vector3f p;
     UniformSampleDisk(u1, u2, p.x(), p.y());
@@ -80,4 +94,45 @@ Vector3f AreaDiskLight::sample(float u1, float u2, Vector3f &ns) const {
     return lightToWorld * p;
 }
 
+void AreaDiskLight::sample(const Vector3f &p, float pEps, Light::SamplePacket &packet) const {
+    using namespace embree;
+
+    float u1[SIMD_WIDTH], u2[SIMD_WIDTH];
+    for (size_t k = 0; k < SIMD_WIDTH; k++) {
+        u1[k] = distribution(generator);
+        u2[k] = distribution(generator);
+    }
+
+    // disk samples in light space
+    SimdFloat x, y;
+    UniformSampleDisk(SimdFloat(u1), SimdFloat(u2), x, y);
+    x *= radius;
+    y *= radius;
+
+    // to world space: the light space z (height) is the same for every sample
+    const Matrix4f &m = lightToWorld.matrix;
+    const SimdFloat psX = m(0, 0) * x + m(0, 1) * y + (m(0, 2) * height + m(0, 3));
+    const SimdFloat psY = m(1, 0) * x + m(1, 1) * y + (m(1, 2) * height + m(1, 3));
+    const SimdFloat psZ = m(2, 0) * x + m(2, 1) * y + (m(2, 2) * height + m(2, 3));
+
+    // incoming (relative to shading point)
+    const SimdFloat dX = psX - p.x();
+    const SimdFloat dY = psY - p.y();
+    const SimdFloat dZ = psZ - p.z();
+    const SimdFloat dist2 = dX * dX + dY * dY + dZ * dZ;
+    const SimdFloat invDist = rsqrt(dist2);
+    packet.wi = SimdVector3f(dX * invDist, dY * invDist, dZ * invDist);
+
+    // light normal is the light space z axis
+    const SimdFloat outgoing = max(SimdFloat(zero),
+            -(m(0, 2) * packet.wi.x + m(1, 2) * packet.wi.y + m(2, 2) * packet.wi.z));
+    const SimdFloat falloff = outgoing * invDist * invDist;
+    packet.li = SimdVector3f(le.x() * falloff, le.y() * falloff, le.z() * falloff);
+
+    for (size_t k = 0; k < SIMD_WIDTH; k++) {
+        const Vec3f w(packet.wi.x[k], packet.wi.y[k], packet.wi.z[k]);
+        packet.vis[k].setSegment(p, pEps, w, dist2[k] * invDist[k], 1e-3f);
+    }
+}
+
 }
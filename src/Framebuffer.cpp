@@ -0,0 +1,105 @@
+/*
+ *  Copyright (C) 2012 Xo Wang
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL XO
+ *  WANG BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ *  AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *  Except as contained in this notice, the name of Xo Wang shall not be
+ *  used in advertising or otherwise to promote the sale, use or other dealings
+ *  in this Software without prior written authorization from Xo Wang.
+ */
+
+#include "Framebuffer.h"
+
+#include "embree/simd/sse.h"
+
+#include <algorithm>
+
+namespace Trayrace {
+
+Framebuffer::Framebuffer(size_t width, size_t height, float exposure) :
+        width(width),
+        height(height),
+        exposure(exposure),
+        hdr(width * height),
+        ldr(width * height),
+        presentNanoseconds(0) {
+}
+
+// tone-maps one RGBA pixel to 8-bit sRGB integers in [0, 255], with red and blue swapped into TrueColorPixel order
+static inline __m128i ToneMap(const Pixel &pixel, const embree::ssef &exposure) {
+    using namespace embree;
+    const ssef x = min(max(ssef(&pixel.r) * exposure, ssef(zero)), ssef(one));
+    // sRGB transfer curve: its linear segment near black, and above it a cheap fit from three chained square
+    // roots; within a quarter of a code of the exact curve
+    const ssef s1 = sqrt(x);
+    const ssef s2 = sqrt(s1);
+    const ssef s3 = sqrt(s2);
+    const ssef fit = 0.662002687f * s1 + 0.684122060f * s2 - 0.323583601f * s3 - 0.0225411470f * x;
+    const ssef srgb = select(x <= ssef(0.0031308f), 12.92f * x, fit);
+    return _mm_cvtps_epi32(shuffle<2, 1, 0, 3>(srgb) * 255.f);
+}
+
+void Framebuffer::resolve(size_t x0, size_t x1, size_t y0, size_t y1) {
+    using namespace embree;
+
+    const ssef scale(exposure);
+    for (size_t j = y0; j < y1; j++) {
+        const Pixel * const src = &hdr[j * width];
+        TrueColorPixel * const dst = &ldr[j * width];
+        size_t i = x0;
+        for (; i + 4 <= x1; i += 4) {
+            const __m128i p01 = _mm_packs_epi32(ToneMap(src[i], scale), ToneMap(src[i + 1], scale));
+            const __m128i p23 = _mm_packs_epi32(ToneMap(src[i + 2], scale), ToneMap(src[i + 3], scale));
+            _mm_storeu_si128((__m128i *) &dst[i], _mm_packus_epi16(p01, p23));
+        }
+        for (; i < x1; i++) {
+            const __m128i p = _mm_packs_epi32(ToneMap(src[i], scale), _mm_setzero_si128());
+            dst[i].integer = _mm_cvtsi128_si32(_mm_packus_epi16(p, p));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(dirtyMutex);
+    if (dirty.xBegin == dirty.xEnd) {
+        dirty = PixelToaster::Rectangle(x0, x1, y0, y1);
+    } else {
+        dirty.xBegin = std::min<int>(dirty.xBegin, x0);
+        dirty.xEnd = std::max<int>(dirty.xEnd, x1);
+        dirty.yBegin = std::min<int>(dirty.yBegin, y0);
+        dirty.yEnd = std::max<int>(dirty.yEnd, y1);
+    }
+}
+
+bool Framebuffer::present(PixelToaster::Display &display) {
+    using namespace std::chrono;
+
+    const time_point start = high_resolution_clock::now();
+    PixelToaster::Rectangle box;
+    {
+        std::lock_guard<std::mutex> lock(dirtyMutex);
+        std::swap(box, dirty);
+    }
+    const bool updated = display.update(ldr, &box);
+    presentNanoseconds += duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+    return updated;
+}
+
+double Framebuffer::takePresentSeconds() {
+    return presentNanoseconds.exchange(0) * 1e-9;
+}
+
+}
@@ -29,42 +29,77 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <iterator>
 #include <iostream>
+#include <limits>
 
 namespace Trayrace {
 
-MaterialLib::FileToNameToMaterial_t MaterialLib::fileToNameToMtl;
+constexpr MaterialLib::MaterialId MaterialLib::DEFAULT_MATERIAL;
 
-const MaterialLib::Material *MaterialLib::load(const std::string &path, const std::string &mtlName) {
+MaterialLib::MaterialLib() :
+        mtlIdToKey(1),
+        materials(1) {
+}
+
+void MaterialLib::request(const std::string &path) {
+    std::lock_guard<std::mutex> lock(internMutex);
+    requestLocked(path);
+}
+
+void MaterialLib::requestLocked(const std::string &path) {
+    if (pathToFile.find(path) == pathToFile.end()) {
+        pathToFile[path] = std::async(std::launch::async, &MaterialLib::parseFile, path).share();
+    }
+}
+
+MaterialLib::MaterialId MaterialLib::intern(const std::string &path, const std::string &mtlName) {
     using namespace std;
 
-    auto fileResult = fileToNameToMtl.find(path);
-    if (fileResult == fileToNameToMtl.end()) {
-        if (parseFile(path)) {
-            fileResult = fileToNameToMtl.find(path);
+    lock_guard<mutex> lock(internMutex);
+    requestLocked(path);
+    const auto key = make_pair(path, mtlName);
+    const auto mtlId = keyToMtlId.find(key);
+    if (mtlId != keyToMtlId.end()) {
+        return mtlId->second;
+    }
+    if (mtlIdToKey.size() > numeric_limits<MaterialId>::max()) {
+        cerr << path << ": Too many materials, using default for \"" << mtlName << "\"\n";
+        return DEFAULT_MATERIAL;
+    }
+    const MaterialId newId = mtlIdToKey.size();
+    keyToMtlId[key] = newId;
+    mtlIdToKey.push_back(key);
+    return newId;
+}
+
+void MaterialLib::finalize() {
+    std::lock_guard<std::mutex> lock(internMutex);
+    materials.resize(mtlIdToKey.size());
+    for (size_t i = DEFAULT_MATERIAL + 1; i < mtlIdToKey.size(); i++) {
+        const auto &key = mtlIdToKey[i];
+        const NameToMaterial_t &nameToMtl = pathToFile[key.first].get();
+        const auto mtl = nameToMtl.find(key.second);
+        if (mtl != nameToMtl.end()) {
+            materials[i] = mtl->second;
         } else {
-            return nullptr;
+            std::cerr << key.first << ": Material \"" << key.second << "\" not found\n";
         }
     }
-    auto &nameToMtl = fileResult->second;
-    const auto mtl = nameToMtl.find(mtlName);
-    if (mtl != nameToMtl.end()) {
-        return &mtl->second;
-    }
-    return nullptr;
 }
 
-bool MaterialLib::parseFile(const std::string &path) {
+MaterialLib::NameToMaterial_t MaterialLib::parseFile(const std::string &path) {
     using namespace std;
+    NameToMaterial_t nameToMtl;
     ifstream ifs(path.c_str(), ifstream::in);
     if (!ifs.is_open()) {
-        return false;
+        cerr << "Material library \"" << path << "\" could not be loaded." << endl;
+        return nameToMtl;
     }
 
     string line;
     vector<string> tokens;
     Material *mtl = nullptr;
-    auto &nameToMtl = fileToNameToMtl[path];
     while (ifs.good()) {
         tokens.clear();
         getline(ifs, line);
@@ -100,7 +135,7 @@ bool MaterialLib::parseFile(const std::string &path) {
     }
     ifs.close();
 
-    return true;
+    return nameToMtl;
 }
 
 }
@@ -36,9 +36,10 @@
 
 namespace Trayrace {
 
-Object::Object(const std::string &path) :
-        path(path) {
-    loadFile(path);
+Object::Object(const std::string &path, MaterialLib &materialLib) :
+        path(path),
+        moving(false) {
+    loadFile(path, materialLib);
 }
 
 Object::~Object() {
@@ -59,18 +60,24 @@ void Object::toEmbree(
         embree::BuildTriangle * const triangles,
         const size_t triangleOffset) const {
     using namespace embree;
+    const size_t stride = moving ? 2 : 1;
     for (size_t i = 0; i < this->vertices.size(); i++) {
-        const Vector3f &v = this->vertices[i];
+        const Vector3f v = startTransform * this->vertices[i];
         // construct embree vertices in place
-        new (&vertices[i + vertexOffset]) BuildVertex(v[0], v[1], v[2]);
+        new (&vertices[stride * i + vertexOffset]) BuildVertex(v[0], v[1], v[2]);
+        if (moving) {
+            const Vector3f motion = endTransform * this->vertices[i] - v;
+            new (&vertices[stride * i + 1 + vertexOffset]) BuildVertex(motion[0], motion[1], motion[2]);
+        }
     }
+    const int triId0 = moving ? int(uint32_t(id0) | 0x80000000u) : id0;
     for (size_t i = 0; i < faces.size(); i++) {
         const Face &f = faces[i];
         // construct triangles
-        new (&triangles[i + triangleOffset]) BuildTriangle(f.vertexIdxs[0] + vertexOffset,
-                f.vertexIdxs[1] + vertexOffset,
-                f.vertexIdxs[2] + vertexOffset,
-                id0,
+        new (&triangles[i + triangleOffset]) BuildTriangle(stride * f.vertexIdxs[0] + vertexOffset,
+                stride * f.vertexIdxs[1] + vertexOffset,
+                stride * f.vertexIdxs[2] + vertexOffset,
+                triId0,
                 i);
     }
 }
@@ -85,7 +92,31 @@ void Object::transformBy(const Transform &transform) {
     }
 }
 
-bool Object::loadFile(const std::string &path) {
+void Object::setMotion(const Transform &start, const Transform &end) {
+    startTransform = start;
+    endTransform = end;
+    startNormalTransform = Transform(start.inverse().transpose());
+    endNormalTransform = Transform(end.inverse().transpose());
+    moving = start.matrix != end.matrix;
+}
+
+Vector3f Object::vertexAt(IndexT i, float time) const {
+    const Vector3f p = startTransform * vertices[i];
+    if (!moving) {
+        return p;
+    }
+    return p + time * (endTransform * vertices[i] - p);
+}
+
+Vector3f Object::normalAt(IndexT i, float time) const {
+    const Vector3f n = startNormalTransform * normals[i];
+    if (!moving) {
+        return n;
+    }
+    return n + time * (endNormalTransform * normals[i] - n);
+}
+
+bool Object::loadFile(const std::string &path, MaterialLib &materialLib) {
     using namespace std;
     using namespace std::chrono;
 
@@ -102,6 +133,7 @@ bool Object::loadFile(const std::string &path) {
     vector<string> tokens;
     string mtlPath;
     string mtlName;
+    MaterialLib::MaterialId matId = MaterialLib::DEFAULT_MATERIAL;
     while (ifs.good()) {
         tokens.clear();
         getline(ifs, line);
@@ -143,7 +175,7 @@ bool Object::loadFile(const std::string &path) {
                 continue;
             }
             face.isQuad = tokens.size() == 5;
-            face.mat = MaterialLib::load(mtlPath, mtlName);
+            face.matId = matId;
 
             const size_t slashesCount = count(tokens[1].begin(), tokens[1].end(), '/');
             switch (slashesCount) {
@@ -193,12 +225,20 @@ bool Object::loadFile(const std::string &path) {
                 continue;
             }
             mtlName = tokens[1];
+            if (!mtlPath.empty()) {
+                matId = materialLib.intern(mtlPath, mtlName);
+            }
         } else if (tokens[0] == "mtllib") {
             if (tokens.size() != 2) {
                 cerr << path << ": Material library command does not have correct number of arguments\n";
                 continue;
             }
             mtlPath = tokens[1];
+            // parse the library while the rest of the geometry loads
+            materialLib.request(mtlPath);
+            if (!mtlName.empty()) {
+                matId = materialLib.intern(mtlPath, mtlName);
+            }
         } else {
             cerr << path << ": Unrecognized token \"" << tokens[0] << "\"\n";
         }
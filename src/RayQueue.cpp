@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2012 Xo Wang
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL XO
+ *  WANG BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ *  AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *  Except as contained in this notice, the name of Xo Wang shall not be
+ *  used in advertising or otherwise to promote the sale, use or other dealings
+ *  in this Software without prior written authorization from Xo Wang.
+ */
+
+#include "RayQueue.h"
+
+#include <algorithm>
+
+namespace Trayrace {
+
+constexpr uint32_t RayQueue::CELL_BITS;
+
+// spreads the low 10 bits of x so that there are two zero bits between each
+static inline uint32_t SpreadBits(uint32_t x) {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+RayQueue::RayQueue() :
+        lower(0.f, 0.f, 0.f),
+        cellScale(1.f, 1.f, 1.f) {
+}
+
+void RayQueue::setBounds(const BoundBox &bounds) {
+    const float cells = float(1 << CELL_BITS);
+    const Vector3f extent = bounds.sizes().cwiseMax(Vector3f::Constant(EPS));
+    lower = EmbV(bounds.min());
+    cellScale = EmbV(Vector3f::Constant(cells).cwiseQuotient(extent));
+}
+
+void RayQueue::push(const Ray &ray, uint32_t tag) {
+    const uint32_t maxCell = (1 << CELL_BITS) - 1;
+    const embree::Vec3f cell = (ray.org - lower) * cellScale;
+    const uint32_t cx = uint32_t(Clamp(cell.x, 0, maxCell));
+    const uint32_t cy = uint32_t(Clamp(cell.y, 0, maxCell));
+    const uint32_t cz = uint32_t(Clamp(cell.z, 0, maxCell));
+    const uint32_t octant = (ray.dir.x < 0.f) | (ray.dir.y < 0.f) << 1 | (ray.dir.z < 0.f) << 2;
+    const uint32_t key = octant << (3 * CELL_BITS) | SpreadBits(cx) << 2 | SpreadBits(cy) << 1 | SpreadBits(cz);
+
+    order.push_back(uint64_t(key) << 32 | rays.size());
+    rays.push_back(ray);
+    tags.push_back(tag);
+}
+
+void RayQueue::sort() {
+    std::sort(order.begin(), order.end());
+}
+
+}
@@ -30,26 +30,61 @@
 #include "Scene.h"
 
 #include "embree/common/accel.h"
+#include "embree/sys/sysinfo.h"
+#include "embree/sys/thread.h"
 
 #include <iostream>
 #include <numeric>
 #include <algorithm>
 
+#include <cmath>
+#include <cstdlib>
+
 namespace Trayrace {
 
-Renderer::Renderer(size_t width, size_t height, size_t nThreads) :
+constexpr size_t Renderer::TILE_SIZE;
+constexpr size_t Renderer::MIN_ADAPTIVE_PASSES;
+constexpr size_t Renderer::MAX_REFINE_RATIO;
+constexpr float Renderer::MIN_LUMINANCE;
+constexpr size_t Renderer::MIN_ROULETTE_BOUNCE;
+
+Renderer::Renderer(size_t width, size_t height, size_t nThreads, float errorThreshold, size_t maxBounces) :
                 width(width),
                 height(height),
                 nThreads(nThreads),
-                currentRow(0),
+                errorThreshold(errorThreshold),
+                maxBounces(maxBounces),
+                tilesX((width + TILE_SIZE - 1) / TILE_SIZE),
+                tilesY((height + TILE_SIZE - 1) / TILE_SIZE),
+                currentTile(0),
+                maxPasses(1),
+                sampleStats(width * height),
+                tileStats(tilesX * tilesY),
+                shadowRays(0),
+                frameIndex(0),
+                renderStartTicks(0),
+                workerTimes(nThreads),
+                tileCounters(tilesX * tilesY),
+                currentRefineTile(0),
+                refineBudget(0),
+                workersSampled(0),
+                refineReady(false),
                 workersRunning(true),
                 workersComplete(0),
+                frameDone(false),
                 workersAwake(false),
                 scene(nullptr),
                 camera(nullptr),
-                pixels(nullptr) {
+                framebuffer(nullptr) {
+    const char * const metricsPath = std::getenv("TRAYRACE_METRICS");
+    if (metricsPath != nullptr && metricsPath[0] != '\0') {
+        metricsStream.open(metricsPath, std::ofstream::out | std::ofstream::app);
+        if (!metricsStream.is_open()) {
+            std::cerr << "Metrics file \"" << metricsPath << "\" could not be opened." << std::endl;
+        }
+    }
     for (size_t i = 0; i < nThreads; i++) {
-        workers.emplace_back(&Renderer::renderThread, this);
+        workers.emplace_back(&Renderer::renderThread, this, i);
     }
 }
 
@@ -65,30 +100,559 @@ Renderer::~Renderer() {
     }
 }
 
-Color Renderer::shade(const Vector3f &n, const Vector3f &wi) {
-    const float c = std::max(0.f, n.dot(wi));
-    return Color(c, c, c);
+SimdFloat Renderer::shade(const Vector3f &n, const SimdVector3f &wi) {
+    return max(SimdFloat(embree::zero), n.x() * wi.x + n.y() * wi.y + n.z() * wi.z);
 }
 
-void Renderer::start(const Scene &scene, const Camera &camera, std::vector<Pixel> &pixels) {
+void Renderer::start(const Scene &scene, const Camera &camera, Framebuffer &framebuffer) {
     using namespace std;
     using namespace std::chrono;
 
     renderStartTime = high_resolution_clock::now();
+    renderStartTicks = __rdtsc();
 
     this->scene = &scene;
     this->camera = &camera;
-    this->pixels = &pixels;
-    currentRow = 0;
+    this->framebuffer = &framebuffer;
+
+    // each pass takes a packet of samples from every light
+    size_t maxSamples = 1;
+    for (auto lightPtr : scene.lights) {
+        maxSamples = max(maxSamples, lightPtr->nSamples);
+    }
+    maxPasses = (maxSamples + SIMD_WIDTH - 1) / SIMD_WIDTH;
+
+    currentTile = 0;
+    shadowRays = 0;
+    currentRefineTile = 0;
+    refineBudget = 0;
+    workersSampled = 0;
+    refineReady = false;
     workersComplete = 0;
+    frameDone = false;
     workersAwake = true;
     workersCondVar.notify_all();
 }
 
-void Renderer::renderThread() {
+bool Renderer::converged(const SampleStats &stats) const {
+    return stats.n >= MIN_ADAPTIVE_PASSES
+            && stats.meanVariance() <= Square(errorThreshold * std::max(stats.mean, MIN_LUMINANCE));
+}
+
+void Renderer::surfaceAt(const Ray &ray, const Hit &hit, const WorkerContext &ctx, SurfacePoint &sp) const {
+    // the motion blur intersector already strips the moving flag from id0
+    const Object &obj = *(*ctx.objects)[hit.id0];
+    const Object::Face &face = obj.faces[hit.id1];
+
+    const auto &ns0 = obj.normalAt(face.normalIdxs[0], ray.time);
+    const auto &ns1 = obj.normalAt(face.normalIdxs[1], ray.time);
+    const auto &ns2 = obj.normalAt(face.normalIdxs[2], ray.time);
+
+    // the intersectors' normal is (v0 - v1) x (v2 - v0), the opposite of the winding order's (v1 - v0) x (v2 - v0)
+    sp.ng = -EigV(hit.Ng).normalized();
+
+    sp.p = EigV(ray.org + hit.t * ray.dir);
+    sp.ns = BaryLerp(ns0, ns1, ns2, hit.u, hit.v).normalized();
+    sp.mat = &scene->materialLib.get(face.matId);
+    sp.time = ray.time;
+}
+
+template<typename Traversal>
+bool Renderer::traceCameraRay(const Traversal &traversal, size_t i, size_t j, float time, SurfacePoint &sp,
+        WorkerContext &ctx) const {
+    Ray ray = camera->generateRay(i, j, time);
+    Hit hit;
+    const uint64_t traversalStart = __rdtsc();
+    traversal.intersect(ray, hit);
+    ctx.traversalTicks += __rdtsc() - traversalStart;
+    if (!hit) {
+        return false;
+    }
+    surfaceAt(ray, hit, ctx, sp);
+    return true;
+}
+
+template<typename Traversal>
+void Renderer::traceCameraRays(const Traversal &traversal, size_t x0, size_t y0, WorkerContext &ctx) {
+    // with motion the visible surface changes over the shutter, so every pass of a pixel traces a new camera ray;
+    // its time is jittered within the stratum of the shutter interval given by the pixel's pass count
+    std::uniform_real_distribution<float> distribution(0.f, 1.f);
+    for (uint32_t slot : ctx.activeSlots) {
+        const size_t i = x0 + slot % TILE_SIZE;
+        const size_t j = y0 + slot / TILE_SIZE;
+        const size_t stratum = sampleStats[j * width + i].n % maxPasses;
+        const float time = (stratum + distribution(ctx.rng)) / maxPasses;
+        SurfacePoint &sp = ctx.surfacePoints[slot];
+        if (!traceCameraRay(traversal, i, j, time, sp, ctx)) {
+            sp.mat = nullptr;
+        }
+    }
+}
+
+void Renderer::queueShadowRays(uint32_t slot, const SurfacePoint &sp, const Vector3f &throughput, WorkerContext &ctx) {
+    using namespace embree;
+
+    Light::SamplePacket &packet = ctx.packet;
+    const Vector3f kd = sp.mat->diffuseColor.cwiseProduct(throughput);
+    const SimdFloat invWidth(1.f / SIMD_WIDTH);
+    for (size_t lightIdx = 0; lightIdx < scene->lights.size(); lightIdx++) {
+        const Light &light = *scene->lights[lightIdx];
+        light.sample(sp.p, EPS, packet);
+
+        // only trace the samples in front of the surface
+        const SimdBool front = sp.ng.x() * packet.wi.x + sp.ng.y() * packet.wi.y + sp.ng.z() * packet.wi.z > 0.f;
+        const SimdFloat weight = shade(sp.ns, packet.wi) * invWidth;
+        for (size_t mask = movemask(front); mask != 0; mask &= mask - 1) {
+            const size_t k = __bsf(mask);
+            const Vector3f contribution(packet.li.x[k] * weight[k] * kd.x(),
+                    packet.li.y[k] * weight[k] * kd.y(),
+                    packet.li.z[k] * weight[k] * kd.z());
+            Ray &ray = packet.vis[k].ray;
+            ray.time = sp.time;
+            ctx.shadowQueue.push(ray, ctx.shadowSamples.size());
+            ctx.shadowSamples.push_back({ slot, uint32_t(lightIdx), contribution });
+        }
+    }
+}
+
+template<typename Traversal>
+void Renderer::traceShadowRays(const Traversal &traversal, WorkerContext &ctx) {
+    // trace in coherent order and add the light that gets through to the pixels
+    ctx.shadowQueue.sort();
+    const uint64_t traversalStart = __rdtsc();
+    for (size_t r = 0; r < ctx.shadowQueue.size(); r++) {
+        const ShadowSample &s = ctx.shadowSamples[ctx.shadowQueue.tag(r)];
+        if (!traversal.occluded(ctx.shadowQueue.ray(r), ctx.occlusionCaches[s.light])) {
+            ctx.passColors[s.slot] += Color(s.contribution.x(), s.contribution.y(), s.contribution.z(), 0.f);
+        }
+    }
+    ctx.traversalTicks += __rdtsc() - traversalStart;
+    ctx.shadowRays += ctx.shadowQueue.size();
+
+    ctx.shadowQueue.clear();
+    ctx.shadowSamples.clear();
+}
+
+// cosine-weighted direction in the hemisphere about the unit vector n
+static inline Vector3f CosineSampleHemisphere(const Vector3f &n, float u1, float u2) {
+    const float r = std::sqrt(u1);
+    const float phi = 2.f * float(M_PI) * u2;
+    const float x = r * std::cos(phi);
+    const float y = r * std::sin(phi);
+    const float z = std::sqrt(std::max(0.f, 1.f - u1));
+
+    // branchless orthonormal basis about n (Duff et al. 2017)
+    const float sign = std::copysign(1.f, n.z());
+    const float a = -1.f / (sign + n.z());
+    const float b = n.x() * n.y() * a;
+    const Vector3f t(1.f + sign * n.x() * n.x() * a, sign * b, -sign * n.x());
+    const Vector3f s(b, sign + n.y() * n.y() * a, -n.y());
+    return x * t + y * s + z * n;
+}
+
+template<typename Traversal>
+void Renderer::tracePaths(const Traversal &traversal, WorkerContext &ctx) {
+    std::uniform_real_distribution<float> distribution(0.f, 1.f);
+
+    // generate: every active pixel starts a path at its visible surface, which was found once for the tile
+    ctx.paths.clear();
+    ctx.pathPoints.clear();
+    for (uint32_t slot : ctx.activeSlots) {
+        ctx.passColors[slot] = Color(0.f, 0.f, 0.f);
+        if (ctx.surfacePoints[slot].mat == nullptr) {
+            continue;
+        }
+        ctx.paths.push(slot, Vector3f::Ones());
+        ctx.pathPoints.push_back(ctx.surfacePoints[slot]);
+    }
+
+    for (size_t bounce = 0; ctx.paths.size() > 0; bounce++) {
+        // shade: connect every path vertex to the lights, and scatter the paths that go on
+        ctx.bouncePaths.clear();
+        ctx.bounceQueue.clear();
+        for (size_t i = 0; i < ctx.paths.size(); i++) {
+            const uint32_t slot = ctx.paths.slots[i];
+            const SurfacePoint &sp = ctx.pathPoints[i];
+            const Vector3f throughput = ctx.paths.throughput(i);
+            queueShadowRays(slot, sp, throughput, ctx);
+            if (bounce == maxBounces) {
+                continue;
+            }
+
+            // Lambertian scattering: with cosine-weighted directions the throughput just takes on the albedo
+            const Vector3f wi = CosineSampleHemisphere(sp.ns, distribution(ctx.rng), distribution(ctx.rng));
+            if (wi.dot(sp.ng) <= 0.f) {
+                continue;
+            }
+            Vector3f next = throughput.cwiseProduct(sp.mat->diffuseColor);
+            if (bounce + 1 >= MIN_ROULETTE_BOUNCE) {
+                const float survival = std::min(1.f, next.maxCoeff());
+                if (distribution(ctx.rng) >= survival) {
+                    continue;
+                }
+                next /= survival;
+            }
+            ctx.bounceQueue.push(Ray(EmbV(sp.p), EmbV(wi), EPS, embree::inf, sp.time), ctx.bouncePaths.size());
+            ctx.bouncePaths.push(slot, next);
+        }
+
+        // shadow: trace the connections of this bounce
+        traceShadowRays(traversal, ctx);
+
+        // extend: find the next vertex of every scattered path
+        ctx.bounceQueue.sort();
+        ctx.paths.clear();
+        ctx.pathPoints.clear();
+        for (size_t r = 0; r < ctx.bounceQueue.size(); r++) {
+            const uint32_t p = ctx.bounceQueue.tag(r);
+            Hit hit;
+            const uint64_t traversalStart = __rdtsc();
+            traversal.intersect(ctx.bounceQueue.ray(r), hit);
+            ctx.traversalTicks += __rdtsc() - traversalStart;
+            if (hit) {
+                ctx.paths.push(ctx.bouncePaths.slots[p], ctx.bouncePaths.throughput(p));
+                ctx.pathPoints.emplace_back();
+                surfaceAt(ctx.bounceQueue.ray(r), hit, ctx, ctx.pathPoints.back());
+            }
+        }
+    }
+}
+
+template<typename Traversal>
+void Renderer::samplePass(const Traversal &traversal, WorkerContext &ctx) {
+    if (maxBounces > 0) {
+        tracePaths(traversal, ctx);
+        return;
+    }
+
+    // queue the shadow rays of every active pixel, so they can be traced in an order that keeps them coherent
+    for (uint32_t slot : ctx.activeSlots) {
+        ctx.passColors[slot] = Color(0.f, 0.f, 0.f);
+        if (ctx.surfacePoints[slot].mat != nullptr) {
+            queueShadowRays(slot, ctx.surfacePoints[slot], Vector3f::Ones(), ctx);
+        }
+    }
+    traceShadowRays(traversal, ctx);
+}
+
+// adds the traversal work the calling thread does while in scope to a tile's counters
+class TileCountersScope {
+public:
+    TileCountersScope(embree::Stat::Counters &tile) :
+            tile(tile),
+            start(embree::Stat::get()) {
+    }
+
+    ~TileCountersScope() {
+        tile += embree::Stat::get();
+        tile -= start;
+    }
+
+protected:
+    embree::Stat::Counters &tile;
+    const embree::Stat::Counters start;
+};
+
+template<typename Traversal>
+void Renderer::sampleTile(const Traversal &traversal, size_t tile, WorkerContext &ctx) {
+    tileCounters[tile].clear();
+    TileCountersScope countersScope(tileCounters[tile]);
+
+    const bool adaptive = errorThreshold > 0.f;
+    const size_t x0 = tile % tilesX * TILE_SIZE;
+    const size_t y0 = tile / tilesX * TILE_SIZE;
+    const size_t x1 = std::min(x0 + TILE_SIZE, width);
+    const size_t y1 = std::min(y0 + TILE_SIZE, height);
+
+    TileStats &ts = tileStats[tile];
+    ts.priority = 0.f;
+    ts.unconverged = 0;
+    ts.sparePasses = 0;
+
+    // slot s of the tile is pixel (x0 + s % TILE_SIZE, y0 + s / TILE_SIZE)
+    ctx.hitSlots.clear();
+    for (size_t j = y0; j < y1; j++) {
+        for (size_t i = x0; i < x1; i++) {
+            const size_t index = j * width + i;
+            const uint32_t slot = (j - y0) * TILE_SIZE + (i - x0);
+            sampleStats[index].clear();
+            // camera rays into a moving scene are traced with every pass instead
+            if (scene->motion || traceCameraRay(traversal, i, j, 0.f, ctx.surfacePoints[slot], ctx)) {
+                ctx.means[slot] = Color(0.f, 0.f, 0.f);
+                ctx.hitSlots.push_back(slot);
+            } else {
+                framebuffer->hdr[index] = Pixel(0.f, 0.f, 0.f);
+            }
+        }
+    }
+
+    // take the passes of all pixels together, dropping pixels as they converge
+    ctx.activeSlots = ctx.hitSlots;
+    for (size_t pass = 0; pass < maxPasses && !ctx.activeSlots.empty(); pass++) {
+        if (scene->motion) {
+            traceCameraRays(traversal, x0, y0, ctx);
+        }
+        samplePass(traversal, ctx);
+        size_t nActive = 0;
+        for (uint32_t slot : ctx.activeSlots) {
+            SampleStats &stats = sampleStats[(y0 + slot / TILE_SIZE) * width + x0 + slot % TILE_SIZE];
+            const Color &c = ctx.passColors[slot];
+            stats.add(Luminance(c));
+            ctx.means[slot] += Color((c - ctx.means[slot]) / stats.n);
+            if (!(adaptive && converged(stats))) {
+                ctx.activeSlots[nActive++] = slot;
+            }
+        }
+        ctx.activeSlots.resize(nActive);
+    }
+
+    for (uint32_t slot : ctx.hitSlots) {
+        const size_t index = (y0 + slot / TILE_SIZE) * width + x0 + slot % TILE_SIZE;
+        const SampleStats &stats = sampleStats[index];
+        const Color &mean = ctx.means[slot];
+        framebuffer->hdr[index] = Pixel(mean.x(), mean.y(), mean.z());
+
+        if (adaptive) {
+            ts.sparePasses += maxPasses - stats.n;
+            if (!converged(stats)) {
+                ts.priority += stats.meanVariance();
+                ts.unconverged++;
+            }
+        }
+    }
+    resolveTile(x0, x1, y0, y1, ctx);
+}
+
+template<typename Traversal>
+void Renderer::refineTile(const Traversal &traversal, size_t tile, WorkerContext &ctx) {
+    TileCountersScope countersScope(tileCounters[tile]);
+
+    const size_t x0 = tile % tilesX * TILE_SIZE;
+    const size_t y0 = tile / tilesX * TILE_SIZE;
+    const size_t x1 = std::min(x0 + TILE_SIZE, width);
+    const size_t y1 = std::min(y0 + TILE_SIZE, height);
+
+    ctx.hitSlots.clear();
+    for (size_t j = y0; j < y1; j++) {
+        for (size_t i = x0; i < x1; i++) {
+            const size_t index = j * width + i;
+            const SampleStats &stats = sampleStats[index];
+            if (stats.n == 0 || converged(stats)) {
+                continue;
+            }
+
+            const uint32_t slot = (j - y0) * TILE_SIZE + (i - x0);
+            if (scene->motion || traceCameraRay(traversal, i, j, 0.f, ctx.surfacePoints[slot], ctx)) {
+                const Pixel &pixel = framebuffer->hdr[index];
+                ctx.means[slot] = Color(pixel.r, pixel.g, pixel.b);
+                ctx.hitSlots.push_back(slot);
+            }
+        }
+    }
+
+    // every round takes one pass from each remaining pixel, as long as the shared budget lasts; the last round only
+    // refines as many pixels as there are passes left
+    ctx.activeSlots = ctx.hitSlots;
+    while (!ctx.activeSlots.empty()) {
+        long long left = refineBudget.load();
+        long long passes;
+        do {
+            passes = std::min<long long>(left, ctx.activeSlots.size());
+        } while (passes > 0 && !refineBudget.compare_exchange_weak(left, left - passes));
+        if (passes <= 0) {
+            break;
+        }
+        ctx.activeSlots.resize(passes);
+        if (scene->motion) {
+            traceCameraRays(traversal, x0, y0, ctx);
+        }
+        samplePass(traversal, ctx);
+        size_t nActive = 0;
+        for (uint32_t slot : ctx.activeSlots) {
+            SampleStats &stats = sampleStats[(y0 + slot / TILE_SIZE) * width + x0 + slot % TILE_SIZE];
+            const Color &c = ctx.passColors[slot];
+            stats.add(Luminance(c));
+            ctx.means[slot] += Color((c - ctx.means[slot]) / stats.n);
+            if (!converged(stats) && stats.n < MAX_REFINE_RATIO * maxPasses) {
+                ctx.activeSlots[nActive++] = slot;
+            }
+        }
+        ctx.activeSlots.resize(nActive);
+    }
+
+    for (uint32_t slot : ctx.hitSlots) {
+        const Color &mean = ctx.means[slot];
+        framebuffer->hdr[(y0 + slot / TILE_SIZE) * width + x0 + slot % TILE_SIZE] = Pixel(mean.x(), mean.y(), mean.z());
+    }
+    resolveTile(x0, x1, y0, y1, ctx);
+}
+
+void Renderer::queueRefinement() {
+    using namespace std;
+
+    long long budget = 0;
+    refineTiles.clear();
+    for (size_t t = 0; t < tileStats.size(); t++) {
+        budget += tileStats[t].sparePasses;
+        if (tileStats[t].unconverged > 0) {
+            refineTiles.push_back(t);
+        }
+    }
+    // spend the budget on the noisiest tiles first
+    sort(refineTiles.begin(), refineTiles.end(), [&](size_t a, size_t b) {
+        return tileStats[a].priority > tileStats[b].priority;
+    });
+    refineBudget = budget;
+}
+
+void Renderer::resolveTile(size_t x0, size_t x1, size_t y0, size_t y1, WorkerContext &ctx) {
+    const uint64_t resolveStart = __rdtsc();
+    framebuffer->resolve(x0, x1, y0, y1);
+    ctx.resolveTicks += __rdtsc() - resolveStart;
+}
+
+void Renderer::finishFrame() {
+    using namespace std;
+    using namespace std::chrono;
+
+    const time_point end = high_resolution_clock::now();
+    const uint64_t endTicks = __rdtsc();
+    const double frameSeconds = duration_cast<duration<double>>(end - renderStartTime).count();
+    // calibrate the cycle counter against the wall clock over the frame
+    const double tickSeconds = frameSeconds / max<uint64_t>(endTicks - renderStartTicks, 1);
+
+    frameCounters.clear();
+    for (const TraversalCounters &tc : tileCounters) {
+        frameCounters += tc;
+    }
+    const auto &normal = frameCounters.all.normal;
+    const auto &shadow = frameCounters.all.shadow;
+    cout << "Frame rendered in "
+            << DurationStr(renderStartTime, end)
+            << " with "
+            << shadowRays
+            << " shadow rays ("
+            << float(shadowRays) / (width * height)
+            << " per pixel, "
+            << refineTiles.size()
+            << " tile(s) refined).\n"
+            << "\tPer camera ray: "
+            << float(normal.trav_nodes) / max<size_t>(normal.travs, 1)
+            << " nodes, "
+            << float(normal.trav_leaves) / max<size_t>(normal.travs, 1)
+            << " leaves, "
+            << float(normal.trav_tris) / max<size_t>(normal.travs, 1)
+            << " triangle tests\n"
+            << "\tPer shadow ray: "
+            << float(shadow.trav_nodes) / max<size_t>(shadow.travs, 1)
+            << " nodes, "
+            << float(shadow.trav_leaves) / max<size_t>(shadow.travs, 1)
+            << " leaves, "
+            << float(shadow.trav_tris) / max<size_t>(shadow.travs, 1)
+            << " triangle tests, "
+            << 100.f * shadow.trav_early_outs / max<size_t>(shadow.travs, 1)
+            << "% occluded early ("
+            << 100.f * shadow.trav_cache_hits / max<size_t>(shadow.travs, 1)
+            << "% by the cached occluder)"
+            << endl;
+
+    if (metricsStream.is_open()) {
+        writeMetrics(frameSeconds, tickSeconds);
+    }
+    frameIndex++;
+}
+
+void Renderer::writeMetrics(double frameSeconds, double tickSeconds) {
+    using namespace std;
+
+    const auto &normal = frameCounters.all.normal;
+    const auto &shadow = frameCounters.all.shadow;
+    uint64_t traversalTicks = 0, resolveTicks = 0, busyTicks = 0;
+    for (const WorkerTimes &wt : workerTimes) {
+        traversalTicks += wt.traversalTicks;
+        resolveTicks += wt.resolveTicks;
+        busyTicks += wt.busyTicks;
+    }
+
+    // one JSON object per line; times are in seconds, summed over workers where they are per-thread
+    ostringstream oss;
+    oss << "{\"frame\":" << frameIndex
+            << ",\"width\":" << width
+            << ",\"height\":" << height
+            << ",\"threads\":" << nThreads
+            << ",\"frame_s\":" << frameSeconds
+            << ",\"primary_rays\":" << normal.travs
+            << ",\"shadow_rays\":" << shadow.travs
+            << ",\"mrays_per_s\":" << (normal.travs + shadow.travs) / frameSeconds * 1e-6
+            << ",\"traversal_s\":" << traversalTicks * tickSeconds
+            << ",\"shading_s\":" << (busyTicks - traversalTicks - resolveTicks) * tickSeconds
+            << ",\"resolve_s\":" << resolveTicks * tickSeconds
+            << ",\"present_s\":" << framebuffer->takePresentSeconds()
+            << ",\"nodes_per_primary_ray\":" << float(normal.trav_nodes) / max<size_t>(normal.travs, 1)
+            << ",\"nodes_per_shadow_ray\":" << float(shadow.trav_nodes) / max<size_t>(shadow.travs, 1)
+            << ",\"shadow_early_outs\":" << shadow.trav_early_outs
+            << ",\"shadow_cache_hits\":" << shadow.trav_cache_hits
+            << ",\"workers\":[";
+    for (size_t i = 0; i < workerTimes.size(); i++) {
+        const double busy = workerTimes[i].busyTicks * tickSeconds;
+        oss << (i ? "," : "")
+                << "{\"busy_s\":" << busy
+                << ",\"idle_s\":" << max(0., frameSeconds - busy) << "}";
+    }
+    oss << "],\"bvh_build\":{\"accel\":\"" << scene->accelType
+            << "\",\"triangle\":\"" << scene->triangleType
+            << "\",\"triangles\":" << scene->numTriangles
+            << ",\"primrefgen_s\":" << scene->buildTimes.primRefGen
+            << ",\"hierarchy_s\":" << scene->buildTimes.hierarchy
+            << ",\"optimize_s\":" << scene->buildTimes.optimize
+            << ",\"total_s\":" << scene->buildTimes.total
+            << ",\"huge_page_bytes\":" << scene->hugePageBytes
+            << "}}";
+    metricsStream << oss.str() << endl;
+}
+
+template<typename Traversal>
+void Renderer::renderTiles(const Traversal &traversal, WorkerContext &ctx) {
+    using namespace std;
+
+    uint64_t busyStart = __rdtsc();
+    const size_t nTiles = tilesX * tilesY;
+    for (size_t t = currentTile++; t < nTiles; t = currentTile++) {
+        sampleTile(traversal, t, ctx);
+    }
+    ctx.busyTicks += __rdtsc() - busyStart;
+
+    if (errorThreshold > 0.f) {
+        // the last worker to finish sampling hands out the spare passes
+        unique_lock<mutex> refineLock(refineMutex);
+        if (++workersSampled == nThreads) {
+            queueRefinement();
+            refineReady = true;
+            refineCondVar.notify_all();
+        } else {
+            refineCondVar.wait(refineLock, [this] {return refineReady;});
+        }
+        refineLock.unlock();
+
+        busyStart = __rdtsc();
+        for (size_t k = currentRefineTile++; k < refineTiles.size(); k = currentRefineTile++) {
+            refineTile(traversal, refineTiles[k], ctx);
+        }
+        ctx.busyTicks += __rdtsc() - busyStart;
+    }
+}
+
+void Renderer::renderThread(size_t workerIdx) {
     using namespace std;
     using namespace std::chrono;
 
+    // workers are spread over the NUMA nodes, and trace and shade the scene's copies on their own node
+    const size_t numaNodes = embree::getNumberOfNumaNodes();
+    const size_t node = workerIdx % numaNodes;
+    if (numaNodes > 1) {
+        embree::setNodeAffinity(node);
+    }
+
     while (workersRunning) {
         unique_lock<mutex> lock(workersMutex);
         while (!workersAwake) {
@@ -99,63 +663,31 @@ void Renderer::renderThread() {
             return;
         }
 
-        Light::VisibilityTester visibilityTester;
-
-        for (size_t j = currentRow++; j < height; j = currentRow++) {
-            for (size_t i = 0; i < width; i++) {
-                const size_t index = j * width + i;
-
-                Ray ray = camera->generateRay(i, j);
-                Hit hit;
-                // trace a ray and write pixel
-                scene->intersect(ray, hit);
-                if (hit) {
-                    const Object &obj = *scene->objects[hit.id0];
-                    const Object::Face &face = obj.faces[hit.id1];
-
-                    const auto &v0 = obj.vertices[face.vertexIdxs[0]];
-                    const auto &v1 = obj.vertices[face.vertexIdxs[1]];
-                    const auto &v2 = obj.vertices[face.vertexIdxs[2]];
-
-                    const auto &ns0 = obj.normals[face.normalIdxs[0]];
-                    const auto &ns1 = obj.normals[face.normalIdxs[1]];
-                    const auto &ns2 = obj.normals[face.normalIdxs[2]];
-
-                    const auto &e1 = v1 - v0;
-                    const auto &e2 = v2 - v0;
-                    const auto &ng = e1.cross(e2).normalized();
-
-                    const auto &sp = BaryLerp(v0, v1, v2, hit.u, hit.v);
-                    const auto &ns = BaryLerp(ns0, ns1, ns2, hit.u, hit.v).normalized();
-
-                    Color c(0.f, 0.f, 0.f);
-                    Vector3f wi;
-                    for (auto lightPtr : scene->lights) {
-                        const Light &light = *lightPtr;
-                        float weight = 1.f / light.nSamples;
-                        for (size_t i = 0; i < light.nSamples; i++) {
-                            const Color lColor = light.sample(sp, EPS, wi, visibilityTester);
-                            if (ng.dot(wi) > 0.f && visibilityTester.unoccluded(*scene)) {
-                                c += Color(shade(ns, wi).array() * (lColor * weight).array());
-                            }
-                        }
-                    }
-
-                    (*pixels)[index] = Pixel(c.x(), c.y(), c.z());
-//                    (*pixels)[index] = Pixel(1.f - hit.u - hit.v, hit.u, hit.v);
-//                    (*pixels)[index] = Pixel(ng.x() * .5f + .5f, ng.y() * .5f + .5f, ng.z() * .5f + .5f);
-                } else {
-                    (*pixels)[index] = Pixel(0.f, 0.f, 0.f);
-                }
-            }
-        }
+        WorkerContext ctx;
+        ctx.objects = &scene->objectsOn(node);
+        ctx.occlusionCaches.resize(scene->lights.size());
+        ctx.surfacePoints.resize(TILE_SIZE * TILE_SIZE);
+        ctx.means.resize(TILE_SIZE * TILE_SIZE);
+        ctx.passColors.resize(TILE_SIZE * TILE_SIZE);
+        ctx.shadowQueue.setBounds(scene->bounds);
+        ctx.bounceQueue.setBounds(scene->bounds);
+        ctx.rng.seed(uint32_t(frameIndex * nThreads + workerIdx));
+        ctx.shadowRays = 0;
+        ctx.traversalTicks = ctx.resolveTicks = ctx.busyTicks = 0;
+
+        TilesVisitor visitor = { *this, ctx };
+        scene->traverse(visitor, node);
+
+        shadowRays += ctx.shadowRays;
+        workerTimes[workerIdx] = { ctx.traversalTicks, ctx.resolveTicks, ctx.busyTicks };
 
         // the thread that finishes first sleeps all others
         workersAwake = false;
 
+        // the frame only counts as done once it is reported, so a restart can't race the report
         if (++workersComplete == nThreads) {
-            const time_point end = high_resolution_clock::now();
-            cout << "Frame rendered in " << DurationStr(renderStartTime, end) << "." << endl;
+            finishFrame();
+            frameDone = true;
         }
     }
 }
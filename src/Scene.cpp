@@ -28,57 +28,246 @@
 #include "Object.h"
 
 #include "embree/common/accel.h"
+#include "embree/sys/sysinfo.h"
+#include "embree/sys/thread.h"
+#include "embree/triangle/triangle4.h"
+#include "embree/triangle/triangle4i.h"
+#include "embree/triangle/triangle8c.h"
+#ifdef __AVX__
+#include "embree/triangle/triangle8.h"
+#endif
 
 #include <iostream>
 #include <numeric>
+#include <limits>
 #include <algorithm>
+#include <thread>
 
 namespace Trayrace {
 
-Scene::Scene() {
+constexpr size_t Scene::FAST_BUILD_MAX_TRIANGLES;
+constexpr size_t Scene::MEMORY_BUDGET_DIVISOR;
+constexpr float Scene::SPATIAL_SPLIT_BUDGET;
+constexpr float Scene::EARLY_SPLIT_THRESHOLD;
+constexpr size_t Scene::TRAVERSAL_PREFETCH_DISTANCE;
+constexpr size_t Scene::PREFETCH_MIN_BYTES;
+constexpr size_t Scene::TREELET_RESTRUCTURING;
+
+// rough BVH4 node bytes per triangle, for memory estimates
+static constexpr size_t NODE_BYTES_PER_TRIANGLE = 48;
+
+// physical memory in bytes; if it can't be queried, it places no limit
+static size_t PhysicalMemory() {
+    const size_t bytes = embree::getPhysicalMemory();
+    return bytes ? bytes : std::numeric_limits<size_t>::max();
+}
+
+// estimated bytes of a BVH over numTriangles triangles of the given type and their vertex array
+static size_t EstimateBytes(const embree::TriangleType &trity, size_t numTriangles, size_t numVertices) {
+    const size_t leafBytes = (numTriangles + trity.blockSize - 1) / trity.blockSize * trity.bytes;
+    const size_t vertexBytes = trity.needVertices ? numVertices * sizeof(embree::BuildVertex) : 0;
+    return leafBytes + vertexBytes + numTriangles * NODE_BYTES_PER_TRIANGLE;
 }
 
-void Scene::build(const std::vector<std::shared_ptr<Object>> &objects, const std::vector<std::shared_ptr<Light>> &lights) {
+Scene::Scene() :
+        memoryBudget(PhysicalMemory() / MEMORY_BUDGET_DIVISOR),
+        spatialSplitBudget(SPATIAL_SPLIT_BUDGET),
+        earlySplitThreshold(EARLY_SPLIT_THRESHOLD),
+        traversalPrefetchDistance(TRAVERSAL_PREFETCH_DISTANCE),
+        treeletRestructuring(TREELET_RESTRUCTURING),
+        depthFirstLayout(true),
+        hugePages(true),
+        numaReplication(true),
+        traverserType(TraverserType::Virtual),
+        hugePageBytes(0),
+        numTriangles(0),
+        motion(false) {
+}
+
+void Scene::build(const std::vector<std::shared_ptr<Object>> &objects,
+        const std::vector<std::shared_ptr<Light>> &lights,
+        BuildPolicy policy) {
     using namespace embree;
     using namespace std;
 
     this->objects = objects;
     this->lights = lights;
+    materialLib.finalize();
 
     const size_t numVertices = accumulate(objects.begin(),
             objects.end(),
             size_t(0),
-            [&](size_t i, shared_ptr<Object> obj) {return i + obj->vertices.size();});
+            [&](size_t i, shared_ptr<Object> obj) {return i + obj->numBuildVertices();});
 
     const size_t numTriangles = accumulate(objects.begin(),
             objects.end(),
             size_t(0),
             [&](size_t i, shared_ptr<Object> obj) {return i + obj->faces.size();});
 
+    rtcSetHugePages(hugePages);
     // allocate vertex memory with embree's allocator
     BuildVertex * const vertices = (BuildVertex *) rtcMalloc(numVertices * sizeof(BuildVertex));
     // allocate faces
     BuildTriangle * const triangles = (BuildTriangle *) rtcMalloc(numTriangles * sizeof(BuildTriangle));
     // give them to Object for converting geometry to embree format
     size_t vertexOffset = 0, triangleOffset = 0;
+    bounds.setEmpty();
+    motion = false;
     for (size_t i = 0; i < objects.size(); i++) {
         const Object &obj = *objects[i];
+        // the region swept over the shutter interval is spanned by the start and end positions
+        for (size_t v = 0; v < obj.vertices.size(); v++) {
+            bounds.extend(obj.vertexAt(v, 0.f));
+            bounds.extend(obj.vertexAt(v, 1.f));
+        }
+        motion |= obj.isMoving();
         obj.toEmbree(i, vertices, vertexOffset, triangles, triangleOffset);
-        vertexOffset += obj.vertices.size();
+        vertexOffset += obj.numBuildVertices();
         triangleOffset += obj.faces.size();
     }
 
-    cout << "Calling embree build with " << numTriangles << " tris and " << numVertices << " verts..." << endl;
+#ifdef __AVX__
+    const TriangleType &precomputed = Triangle8::type;
+#else
+    const TriangleType &precomputed = Triangle4::type;
+#endif
+    float splitBudget = spatialSplitBudget;
+    if (policy == BuildPolicy::Auto) {
+        const size_t bytes = EstimateBytes(precomputed, numTriangles, numVertices);
+        if (bytes > memoryBudget) {
+            policy = BuildPolicy::LowMemory;
+        } else if (numTriangles < FAST_BUILD_MAX_TRIANGLES) {
+            policy = BuildPolicy::FastBuild;
+        } else {
+            // spatial and early split references get what the memory budget leaves, down to none as the estimate
+            // nears it
+            const size_t splitBytes = EstimateBytes(precomputed, size_t(numTriangles * (1.f + spatialSplitBudget)),
+                    numVertices);
+            if (splitBytes > memoryBudget) {
+                splitBudget = spatialSplitBudget * float(memoryBudget - bytes) / float(splitBytes - bytes);
+            }
+            policy = BuildPolicy::FastTrace;
+        }
+    }
+
+    // moving geometry needs the motion blur BVH, which interpolates bounds and vertices to each ray's time, and only
+    // takes indexed triangles; precomputed triangles only have the Moeller-Trumbore intersector
+    if (motion) {
+        accelType = "bvh4mb";
+        triangleType = "triangle4i.pluecker";
+    } else if (policy == BuildPolicy::FastBuild) {
+        accelType = "bvh4";
+        triangleType = precomputed.name + ".moeller";
+    } else if (policy == BuildPolicy::FastTrace) {
+        accelType = "bvh4.spatialsplit";
+        triangleType = precomputed.name + ".moeller";
+    } else {
+        // quantization moves vertices by at most half a step of 1/65535 of their block's extent
+        accelType = "bvh4";
+        triangleType = Triangle8c::type.name + ".moeller";
+    }
+
+    rtcSetSpatialSplitBudget(splitBudget);
+    // split references cost build time and memory, which the other policies favor over trace speed
+    rtcSetEarlySplitThreshold(policy == BuildPolicy::FastTrace ? earlySplitThreshold : 0.f);
+    rtcSetTreeletRestructuring(treeletRestructuring);
+    const bool relayout = depthFirstLayout && policy == BuildPolicy::FastTrace && !motion;
+    rtcSetDepthFirstLayout(relayout);
+
+    cout << "Calling embree build of " << accelType << " over " << triangleType << " with " << numTriangles
+            << " tris and " << numVertices << " verts";
+    if (policy == BuildPolicy::FastTrace && !motion) {
+        cout << " and a split budget of " << splitBudget;
+    }
+    cout << "..." << endl;
 
     // create an accel structure
-    Ref<Accel> accel = rtcCreateAccel("bvh4.spatialsplit",
-            "triangle4i.pluecker",
+    Ref<Accel> accel = rtcCreateAccel(accelType.c_str(),
+            triangleType.c_str(),
             triangles,
             numTriangles,
             vertices,
             numVertices);
+    // give the blocks the tree was built in back to the system rather than keeping them pooled for the next build
+    if (relayout) {
+        rtcFreeMemory();
+    }
+    // intersectors take the prefetch distance set when they are created
+    rtcSetTraversalPrefetchDistance(accel->bytes() >= PREFETCH_MIN_BYTES ? traversalPrefetchDistance : 0);
     // get interface to accel
     intersector = accel->queryInterface<Intersector>();
+    traverserType = classify(intersector.ptr);
+    buildTimes = accel->buildTimes;
+
+    // each copy costs as much memory as the structure and the objects it shades
+    replicas.clear();
+    const size_t numaNodes = getNumberOfNumaNodes();
+    const size_t objectBytes = accumulate(objects.begin(),
+            objects.end(),
+            size_t(0),
+            [&](size_t i, shared_ptr<Object> obj) {return i + obj->bytes();});
+    if (numaReplication && numaNodes > 1 && (numaNodes + 1) * (accel->bytes() + objectBytes) <= memoryBudget) {
+        replicate(accel, numaNodes);
+    }
+
+    hugePageBytes = getHugePageMemory();
+    cout << "Huge pages back " << hugePageBytes / (1 << 20) << " MB of memory." << endl;
+    this->numTriangles = numTriangles;
+}
+
+// recognizes the traversers the policies create, so traversal can skip the interface
+Scene::TraverserType Scene::classify(const embree::Intersector *intersector) {
+    using namespace embree;
+
+    if (dynamic_cast<const BVH4Intersector<PrecomputedIntersector> *>(intersector)) {
+        return TraverserType::Precomputed;
+    } else if (dynamic_cast<const BVH4Intersector<Triangle8cIntersectorMoellerTrumbore> *>(intersector)) {
+        return TraverserType::Compressed;
+    } else if (dynamic_cast<const BVH4MBIntersector<Triangle4iIntersectorPlueckerMB> *>(intersector)) {
+        return TraverserType::Motion;
+    }
+    return TraverserType::Virtual;
+}
+
+void Scene::replicate(const embree::Ref<embree::Accel> &accel, size_t numaNodes) {
+    using namespace embree;
+
+    replicas.resize(numaNodes);
+    std::vector<std::thread> threads;
+    for (size_t n = 0; n < numaNodes; n++) {
+        threads.emplace_back([this, &accel, n] {
+            // pages are placed on the node of the thread that first touches them; a copy made elsewhere is useless
+            Replica &replica = replicas[n];
+            if (!setNodeAffinity(n)) {
+                return;
+            }
+            try {
+                Ref<Accel> copy = rtcCopyAccel(accel);
+                if (!copy) {
+                    return;
+                }
+                replica.intersector = copy->queryInterface<Intersector>();
+                replica.traverserType = classify(replica.intersector.ptr);
+                for (const std::shared_ptr<Object> &obj: objects) {
+                    replica.objects.push_back(std::make_shared<Object>(*obj));
+                }
+            } catch (const std::exception &e) {
+                replica.intersector = null;
+            }
+        });
+    }
+    for (std::thread &t: threads) {
+        t.join();
+    }
+
+    for (const Replica &replica: replicas) {
+        if (!replica.intersector) {
+            std::cout << "Could not copy " << accelType << " onto every NUMA node; rendering from one copy." << std::endl;
+            replicas.clear();
+            return;
+        }
+    }
+    std::cout << "Copied " << accelType << " onto " << numaNodes << " NUMA nodes." << std::endl;
 }
 
 }
@@ -39,6 +39,7 @@
 #include <random>
 #include <thread>
 #include <chrono>
+#include <future>
 
 #include <cstdlib>
 
@@ -54,6 +55,9 @@ int main(const int argc, const char * const argv[]) {
 
     const size_t width = 1024;
     const size_t height = 1024;
+    const float errorThreshold = .05f;
+    // diffuse bounces per path; 0 renders direct lighting only
+    const size_t maxBounces = 0;
 
 //    Transform look = Transform::LookAt(Vector3f(5, 2, 0), Vector3f(0, 0, 0), Vector3f(0, 1, 0));
     InteractiveCamera camera(width, height, {-.5f, .5f, -.5f, .5f}, 30.f * float(M_PI / 180.0));
@@ -62,13 +66,21 @@ int main(const int argc, const char * const argv[]) {
     camera.r = 5.5f;
     camera.recompute();
 
-    vector<shared_ptr<Object>> objects;
+    Scene scene;
+
+    // load objects concurrently; they share the scene's material library
+    vector<future<shared_ptr<Object>>> loads;
     for (size_t i = 1; i < argc; i++) {
-        Object *obj = new Object(argv[i]);
+        const string path(argv[i]);
+        loads.push_back(async(launch::async, [&scene, path]() {
+            return make_shared<Object>(path, scene.materialLib);
+        }));
+    }
+    vector<shared_ptr<Object>> objects;
+    for (auto &load : loads) {
+        shared_ptr<Object> obj = load.get();
         if (!obj->faces.empty()) {
-            objects.emplace_back(obj);
-        } else {
-            delete obj;
+            objects.push_back(obj);
         }
     }
 
@@ -90,20 +102,19 @@ int main(const int argc, const char * const argv[]) {
             1.f,
             0.f));
 
-    Display display("Trayrace", width, height);
-    Scene scene;
-    vector<Pixel> pixels(width * height);
-    Renderer renderer(width, height, thread::hardware_concurrency());
+    Display display("Trayrace", width, height, Output::Default, Mode::TrueColor);
+    Framebuffer framebuffer(width, height);
+    Renderer renderer(width, height, thread::hardware_concurrency(), errorThreshold, maxBounces);
 
     scene.build(objects, lights);
-    renderer.start(scene, camera, pixels);
+    renderer.start(scene, camera, framebuffer);
     display.listener(&camera);
     while (display.open()) {
         if (renderer.done()) {
-            renderer.start(scene, camera, pixels);
+            renderer.start(scene, camera, framebuffer);
         }
         this_thread::sleep_for(chrono::nanoseconds(1000000000 / 20));
-        display.update(pixels);
+        framebuffer.present(display);
     }
 
     return EXIT_SUCCESS;